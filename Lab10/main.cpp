@@ -1,4 +1,5 @@
 #include <opencv2/opencv.hpp>
+#include "../Synth/synth.hpp"
 #include <vector>
 using namespace cv;
 using namespace std;
@@ -20,6 +21,19 @@ static Mat loadImage(const string &filename, int flags = IMREAD_COLOR)
     return Mat();
 }
 
+// ---------- Helper: Synthetic stand-in for hod.jpg ----------
+// Filled circles with known centres and radii, printed as ground truth
+static Mat synthCircleImage(float minR, float maxR)
+{
+    vector<Vec3f> truth;
+    Mat im = synth::render(synth::circles(600, 800, 6, minR, maxR, 1, &truth, 3,
+                                          Scalar(60, 200, 230), Scalar(90, 60, 40)));
+    cout << "Using a synthetic image, ground truth:" << endl;
+    for (const Vec3f &c : truth)
+        cout << "  center (" << c[0] << ", " << c[1] << "), r=" << c[2] << endl;
+    return im;
+}
+
 // ---------- Helper: Wait for space or Q ----------
 static bool waitForSpace()
 {
@@ -40,16 +54,13 @@ static bool waitForSpace()
 // ---------- Task A: Manual Hough Circle Detection ----------
 void houghCircleManual()
 {
-    // Step 1: Load the image in color
+    // Step 1: Define the radius we're searching for
+    const int R = 89;
+
+    // Step 2: Load the image in color (synthetic circles of radius R without it)
     Mat imColor = loadImage("hod.jpg", IMREAD_COLOR);
     if (imColor.empty())
-    {
-        cerr << "Error: Cannot load hod.jpg. Please create a test image with circles." << endl;
-        return;
-    }
-
-    // Step 2: Define the radius we're searching for
-    const int R = 89;
+        imColor = synthCircleImage(R, R);
 
     // Step 3: Split into channels and display
     vector<Mat> channels;
@@ -240,10 +251,7 @@ void houghCircleBuiltin()
     // Load the image
     Mat imColor = loadImage("hod.jpg", IMREAD_COLOR);
     if (imColor.empty())
-    {
-        cerr << "Error: Cannot load hod.jpg" << endl;
-        return;
-    }
+        imColor = synthCircleImage(20, 120);
 
     // Convert to grayscale
     Mat gray;
@@ -306,7 +314,7 @@ int main()
 {
     cout << "Hough Transform Circle Detection" << endl;
     cout << "Controls: SPACE=next slide, Q=quit, ESC=skip to next task" << endl;
-    cout << "Note: Please ensure 'hod.jpg' exists with circles drawn on it." << endl;
+    cout << "Note: without 'hod.jpg' a synthetic image with circles is used." << endl;
     cout << endl;
 
     houghCircleBuiltin();
@@ -1,4 +1,5 @@
 #include <opencv2/opencv.hpp>
+#include "../Lab5/equalize.hpp"
 #include <vector>
 #include <iostream>
 using namespace cv;
@@ -76,6 +77,14 @@ int regionGrowing(Mat im, Point p0, Point &pbf, Point &pja)
     return count;
 }
 
+// Shrink a decoded frame for preview/analysis. Video frames cannot use the
+// reduced JPEG decode path, so INTER_AREA (a fast box filter for integer
+// factors) is the cheapest resampler that does not alias.
+void shrinkFrame(const Mat &frame, Mat &small, double scale)
+{
+    resize(frame, small, Size(), scale, scale, INTER_AREA);
+}
+
 // ---------- Task 1: Play video in color and grayscale ----------
 
 void task1_PlayVideo(const string &videoFile)
@@ -288,15 +297,8 @@ void task6_HistogramEqualization(const string &videoFile)
         if (frame.empty())
             break;
 
-        Mat ycrcb, equalized;
-        cvtColor(frame, ycrcb, COLOR_BGR2YCrCb);
-
-        vector<Mat> channels;
-        split(ycrcb, channels);
-        equalizeHist(channels[0], channels[0]);
-        merge(channels, ycrcb);
-
-        cvtColor(ycrcb, equalized, COLOR_YCrCb2BGR);
+        Mat equalized = frame.clone();
+        equalize::equalizeLuma(equalized);
 
         imshow("Task 6: Original", frame);
         imshow("Task 6: Histogram Equalized", equalized);
@@ -378,7 +380,7 @@ void task8_MotionDetection(const string &videoFile)
 
         if (i == 5) // Use frame 5 as background
         {
-            resize(frame, background, Size(), 0.25, 0.25, INTER_LINEAR);
+            shrinkFrame(frame, background, 0.25);
         }
     }
 
@@ -395,7 +397,7 @@ void task8_MotionDetection(const string &videoFile)
 
         // Resize to quarter size
         Mat frameSmall;
-        resize(frame, frameSmall, Size(), 0.25, 0.25, INTER_LINEAR);
+        shrinkFrame(frame, frameSmall, 0.25);
 
         // c) Calculate absolute difference
         Mat diff1, diff2, diff;
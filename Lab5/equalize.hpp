@@ -0,0 +1,177 @@
+#pragma once
+// Global histogram equalization of the luma of 8-bit BGR images, shared by
+// Lab5 (still images) and Lab12 (video frames). Two passes over the
+// interleaved pixels, no YCrCb planes: pass 1 counts Y, pass 2 adds
+// lut[Y] - Y to B, G and R. Luma and the saturating add run on universal
+// intrinsics; the histogram counts and the lut[Y] lookup stay scalar, as
+// they are gathers.
+#include <opencv2/opencv.hpp>
+#include <opencv2/core/hal/intrin.hpp>
+#include <vector>
+
+namespace equalize
+{
+using namespace cv;
+using namespace std;
+
+// Integer BT.601 luma with the same fixed-point weights cvtColor uses for
+// BGR2YCrCb on 8-bit data, so the histogram matches the Y plane exactly.
+// The weights sum to 1 << 14, so 16-bit input cannot overflow an int.
+template <typename T>
+inline int lumaBGR(const T *p)
+{
+    return (p[0] * 1868 + p[1] * 9617 + p[2] * 4899 + 8192) >> 14;
+}
+
+// lumaBGR of n interleaved pixels into y
+inline void lumaRow(const uchar *p, int n, uchar *y)
+{
+    int x = 0;
+#if CV_SIMD
+    // (b, g) and (r, 1) pairs, as v_zip lays them out; the 1 carries the rounding
+    v_int16 wbg, wr1, t;
+    v_zip(vx_setall_s16(1868), vx_setall_s16(9617), wbg, t);
+    v_zip(vx_setall_s16(4899), vx_setall_s16(8192), wr1, t);
+    const v_int16 one = vx_setall_s16(1);
+    for (; x <= n - CV_SIMD_WIDTH; x += CV_SIMD_WIDTH)
+    {
+        v_uint8 c[3];
+        v_load_deinterleave(p + 3 * x, c[0], c[1], c[2]);
+        v_uint16 w[3][2];
+        for (int k = 0; k < 3; ++k)
+            v_expand(c[k], w[k][0], w[k][1]);
+        v_int16 half[2];
+        for (int h = 0; h < 2; ++h)
+        {
+            v_int16 bg[2], r1[2];
+            v_zip(v_reinterpret_as_s16(w[0][h]), v_reinterpret_as_s16(w[1][h]), bg[0], bg[1]);
+            v_zip(v_reinterpret_as_s16(w[2][h]), one, r1[0], r1[1]);
+            v_int32 lo = v_dotprod(r1[0], wr1, v_dotprod(bg[0], wbg));
+            v_int32 hi = v_dotprod(r1[1], wr1, v_dotprod(bg[1], wbg));
+            half[h] = v_pack(lo >> 14, hi >> 14);
+        }
+        v_store(y + x, v_pack_u(half[0], half[1]));
+    }
+#endif
+    for (; x < n; ++x)
+        y[x] = uchar(lumaBGR(p + 3 * x));
+}
+
+// B, G and R of n interleaved pixels plus d[x], saturated
+inline void addDeltaRow(uchar *p, const short *d, int n)
+{
+    int x = 0;
+#if CV_SIMD
+    for (; x <= n - CV_SIMD_WIDTH; x += CV_SIMD_WIDTH)
+    {
+        v_uint8 c[3];
+        v_load_deinterleave(p + 3 * x, c[0], c[1], c[2]);
+        const v_int16 d0 = vx_load(d + x), d1 = vx_load(d + x + CV_SIMD_WIDTH / 2);
+        for (int k = 0; k < 3; ++k)
+        {
+            v_uint16 lo, hi;
+            v_expand(c[k], lo, hi);
+            c[k] = v_pack_u(v_reinterpret_as_s16(lo) + d0, v_reinterpret_as_s16(hi) + d1);
+        }
+        v_store_interleave(p + 3 * x, c[0], c[1], c[2]);
+    }
+#endif
+    for (; x < n; ++x)
+        for (int k = 0; k < 3; ++k)
+            p[3 * x + k] = saturate_cast<uchar>(p[3 * x + k] + d[x]);
+}
+
+// Same mapping as equalizeHist: CDF scaled so the first occupied bin goes to 0
+inline void buildLUT(const int hist[256], int total, uchar lut[256])
+{
+    int i = 0;
+    while (i < 256 && hist[i] == 0)
+        ++i;
+    if (i == 256 || hist[i] == total)
+    {
+        for (int k = 0; k < 256; ++k)
+            lut[k] = saturate_cast<uchar>(i == 256 ? k : i);
+        return;
+    }
+    float scale = 255.0f / (total - hist[i]);
+    int sum = 0;
+    for (int k = 0; k <= i; ++k)
+        lut[k] = 0;
+    for (++i; i < 256; ++i)
+    {
+        sum += hist[i];
+        lut[i] = saturate_cast<uchar>(sum * scale);
+    }
+}
+
+// Equalize the luma of a CV_8UC3 image in place. Both passes run over row
+// bands merged in order, so the result does not depend on scheduling.
+// Adding lut[Y] - Y equals converting to YCrCb, remapping Y and converting
+// back up to chroma rounding (within +-1). The shift depends on Y, not on
+// each channel, so the output histogram is not a per-channel remap of the
+// input one; if outCounts (3 x 256, channel-major) is given it is counted
+// while pass 2 writes the pixels instead of in a separate pass.
+inline void equalizeLuma(Mat &im, int *outCounts = nullptr)
+{
+    CV_Assert(im.type() == CV_8UC3);
+    const int rows = im.rows, cols = im.cols;
+    const int bands = max(1, min(getNumThreads(), rows));
+
+    vector<int> bandHist(bands * 256, 0);
+    parallel_for_(Range(0, bands), [&](const Range &r)
+    {
+        vector<uchar> luma(cols);
+        for (int b = r.start; b < r.end; ++b)
+        {
+            int *h = &bandHist[b * 256];
+            for (int y = b * rows / bands; y < (b + 1) * rows / bands; ++y)
+            {
+                lumaRow(im.ptr<uchar>(y), cols, &luma[0]);
+                for (int x = 0; x < cols; ++x)
+                    ++h[luma[x]];
+            }
+        }
+    });
+
+    int hist[256] = {0};
+    for (int b = 0; b < bands; ++b)
+        for (int k = 0; k < 256; ++k)
+            hist[k] += bandHist[b * 256 + k];
+
+    uchar lut[256];
+    buildLUT(hist, rows * cols, lut);
+    short delta[256];
+    for (int k = 0; k < 256; ++k)
+        delta[k] = short(lut[k] - k);
+
+    vector<int> outBand(outCounts ? bands * 3 * 256 : 0, 0);
+    parallel_for_(Range(0, bands), [&](const Range &r)
+    {
+        vector<uchar> luma(cols);
+        vector<short> d(cols);
+        for (int b = r.start; b < r.end; ++b)
+        {
+            int *oh = outCounts ? &outBand[b * 3 * 256] : nullptr;
+            for (int y = b * rows / bands; y < (b + 1) * rows / bands; ++y)
+            {
+                uchar *p = im.ptr<uchar>(y);
+                lumaRow(p, cols, &luma[0]);
+                for (int x = 0; x < cols; ++x)
+                    d[x] = delta[luma[x]];
+                addDeltaRow(p, &d[0], cols);
+                if (oh)
+                    for (int x = 0; x < cols; ++x, p += 3)
+                        ++oh[p[0]], ++oh[256 + p[1]], ++oh[512 + p[2]];
+            }
+        }
+    });
+
+    if (outCounts)
+    {
+        fill(outCounts, outCounts + 3 * 256, 0);
+        for (int b = 0; b < bands; ++b)
+            for (int i = 0; i < 3 * 256; ++i)
+                outCounts[i] += outBand[b * 3 * 256 + i];
+    }
+}
+} // namespace equalize
@@ -1,79 +1,653 @@
 #include <opencv2/opencv.hpp>
+#include "equalize.hpp"
+#include <fstream>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <deque>
+#include <map>
 using namespace cv;
 using namespace std;
 
-// Helper: try multiple likely paths/extensions to load an image from the workspace
-static Mat loadImage(const string &filename)
+// Helper: all the places an image might live in the workspace, in lookup order
+static vector<string> candidatePaths(const string &filename)
 {
-    Mat im = imread(filename);
-    if (!im.empty())
-        return im;
     size_t pos = filename.find_last_of('.');
+    string altName;
     if (pos != string::npos)
     {
         string base = filename.substr(0, pos);
         string ext = filename.substr(pos);
         if (ext == ".jpg")
-            im = imread(base + ".JPG");
+            altName = base + ".JPG";
         else if (ext == ".JPG")
-            im = imread(base + ".jpg");
-        if (!im.empty())
-            return im;
+            altName = base + ".jpg";
     }
+    vector<string> paths = {filename};
+    if (!altName.empty())
+        paths.push_back(altName);
     vector<string> prefixes = {"kepek/", "../kepek/", "/home/progenor/Documents/code/Sch/Image/kepek/"};
     for (const auto &p : prefixes)
     {
-        im = imread(p + filename);
+        paths.push_back(p + filename);
+        if (!altName.empty())
+            paths.push_back(p + altName);
+    }
+    return paths;
+}
+
+// Helper: read width/height from a JPEG SOF or PNG IHDR header without decoding
+static bool probeImageSize(const string &path, Size &size)
+{
+    ifstream f(path, ios::binary);
+    if (!f)
+        return false;
+    unsigned char sig[8];
+    if (!f.read(reinterpret_cast<char *>(sig), 8))
+        return false;
+
+    if (sig[0] == 0x89 && sig[1] == 'P' && sig[2] == 'N' && sig[3] == 'G')
+    {
+        unsigned char ihdr[16];
+        if (!f.read(reinterpret_cast<char *>(ihdr), 16))
+            return false;
+        size.width = (ihdr[8] << 24) | (ihdr[9] << 16) | (ihdr[10] << 8) | ihdr[11];
+        size.height = (ihdr[12] << 24) | (ihdr[13] << 16) | (ihdr[14] << 8) | ihdr[15];
+        return size.width > 0 && size.height > 0;
+    }
+
+    if (sig[0] != 0xFF || sig[1] != 0xD8)
+        return false;
+    f.seekg(2);
+    while (f)
+    {
+        int c = f.get();
+        if (c != 0xFF)
+            continue;
+        int marker = f.get();
+        while (marker == 0xFF)
+            marker = f.get();
+        if (marker == 0xD8 || marker == 0x01 || (marker >= 0xD0 && marker <= 0xD7))
+            continue;
+        unsigned char len[2];
+        if (!f.read(reinterpret_cast<char *>(len), 2))
+            return false;
+        int segLen = (len[0] << 8) | len[1];
+        // SOF0..SOF15, except DHT (C4), JPG (C8) and DAC (CC)
+        if (marker >= 0xC0 && marker <= 0xCF && marker != 0xC4 && marker != 0xC8 && marker != 0xCC)
+        {
+            unsigned char sof[5];
+            if (!f.read(reinterpret_cast<char *>(sof), 5))
+                return false;
+            size.height = (sof[1] << 8) | sof[2];
+            size.width = (sof[3] << 8) | sof[4];
+            return size.width > 0 && size.height > 0;
+        }
+        f.seekg(segLen - 2, ios::cur);
+    }
+    return false;
+}
+
+// Helper: JPEG files start with the SOI marker FF D8
+static bool isJpegFile(const string &path)
+{
+    ifstream f(path, ios::binary);
+    return f.get() == 0xFF && f.get() == 0xD8;
+}
+
+// Helper: decode an image at roughly `scale` times its stored size.
+// When the target is at least 2x smaller the decoder does the coarse 2/4/8x
+// step itself (JPEG DCT scaling via IMREAD_REDUCED_*), INTER_AREA does the rest.
+// Other formats are read at their own depth, so 16-bit PNG/TIFF stay 16-bit.
+static Mat readScaled(const string &path, double scale)
+{
+    if (scale >= 1.0)
+        return imread(path, IMREAD_COLOR | IMREAD_ANYDEPTH);
+
+    int factor = 1;
+    while (factor < 8 && scale * factor * 2 <= 1.0)
+        factor *= 2;
+
+    int flags = IMREAD_COLOR | IMREAD_ANYDEPTH;
+    if (!isJpegFile(path))
+        factor = 1;
+    else if (factor == 2)
+        flags = IMREAD_REDUCED_COLOR_2;
+    else if (factor == 4)
+        flags = IMREAD_REDUCED_COLOR_4;
+    else if (factor == 8)
+        flags = IMREAD_REDUCED_COLOR_8;
+
+    Mat im = imread(path, flags);
+    if (im.empty())
+        return im;
+
+    double rest = scale * factor;
+    Size target(max(1, cvRound(im.cols * rest)), max(1, cvRound(im.rows * rest)));
+    if (target != im.size())
+        resize(im, im, target, 0, 0, INTER_AREA);
+    return im;
+}
+
+// Helper: try multiple likely paths/extensions to load an image from the workspace.
+// `scale` < 1 gives a reduced-resolution decode for previews.
+static Mat loadImage(const string &filename, double scale = 1.0)
+{
+    for (const auto &path : candidatePaths(filename))
+    {
+        Mat im = readScaled(path, scale);
         if (!im.empty())
             return im;
-        if (pos != string::npos)
-        {
-            string base = filename.substr(0, pos);
-            string ext = filename.substr(pos);
-            if (ext == ".jpg")
-                im = imread(p + base + ".JPG");
-            else if (ext == ".JPG")
-                im = imread(p + base + ".jpg");
-            if (!im.empty())
-                return im;
+    }
+    return Mat();
+}
+
+// Helper: load an image so that it fits inside `target`, keeping the aspect ratio
+static Mat loadImage(const string &filename, Size target)
+{
+    for (const auto &path : candidatePaths(filename))
+    {
+        Size stored;
+        if (!probeImageSize(path, stored))
+        {
+            Mat im = imread(path, IMREAD_COLOR | IMREAD_ANYDEPTH);
+            if (im.empty())
+                continue;
+            double scale = min(1.0, min(double(target.width) / im.cols, double(target.height) / im.rows));
+            if (scale < 1.0)
+                resize(im, im, Size(max(1, cvRound(im.cols * scale)), max(1, cvRound(im.rows * scale))), 0, 0, INTER_AREA);
+            return im;
         }
+        double scale = min(double(target.width) / stored.width, double(target.height) / stored.height);
+        Mat im = readScaled(path, scale);
+        if (!im.empty())
+            return im;
     }
     return Mat();
 }
 
-// Equalize image in Y channel (works for color and grayscale)
-static void equalizeHistogram(Mat &im)
+// Helper: the loader the command line asks for, fitted into `fit` if that
+// is set, else scaled by `scale`
+static Mat loadPreview(const string &filename, double scale, Size fit)
+{
+    return fit.area() > 0 ? loadImage(filename, fit) : loadImage(filename, scale);
+}
+
+// ---------- Histogram engine ----------
+// Per-channel histograms of an interleaved 8U or 16U image, counted in one
+// read of the pixels. counts is laid out channel-major: counts[c * bins + v].
+struct ChannelHist
+{
+    int channels = 0;
+    int bins = 0;
+    int shift = 0; // 16U values are binned as v >> shift
+    vector<int> counts;
+
+    int *operator[](int c) { return &counts[c * bins]; }
+    const int *operator[](int c) const { return &counts[c * bins]; }
+};
+
+// Count rows [y0, y1) into `copies` interleaved sub-histograms per channel.
+// Neighbouring pixels go to different copies, so a run of equal values does
+// not keep incrementing the same counter (store-to-load stalls).
+template <typename T>
+static void accumulateHistBand(const Mat &im, const Mat &mask, int y0, int y1,
+                               int shift, int bins, int copies, int *sub)
+{
+    const int cn = im.channels(), cols = im.cols;
+    const int stride = cn * bins;
+    for (int y = y0; y < y1; ++y)
+    {
+        const T *p = im.ptr<T>(y);
+        const uchar *m = mask.empty() ? nullptr : mask.ptr<uchar>(y);
+        int x = 0;
+        if (!m && cn == 3 && copies == 4)
+        {
+            int *h0 = sub, *h1 = sub + stride, *h2 = sub + 2 * stride, *h3 = sub + 3 * stride;
+            for (; x + 4 <= cols; x += 4, p += 12)
+            {
+                ++h0[p[0] >> shift], ++h0[bins + (p[1] >> shift)], ++h0[2 * bins + (p[2] >> shift)];
+                ++h1[p[3] >> shift], ++h1[bins + (p[4] >> shift)], ++h1[2 * bins + (p[5] >> shift)];
+                ++h2[p[6] >> shift], ++h2[bins + (p[7] >> shift)], ++h2[2 * bins + (p[8] >> shift)];
+                ++h3[p[9] >> shift], ++h3[bins + (p[10] >> shift)], ++h3[2 * bins + (p[11] >> shift)];
+            }
+        }
+        for (; x < cols; ++x, p += cn)
+        {
+            if (m && !m[x])
+                continue;
+            int *h = sub + (x & (copies - 1)) * stride;
+            for (int c = 0; c < cn; ++c)
+                ++h[c * bins + (p[c] >> shift)];
+        }
+    }
+}
+
+// Histogram of every channel of `im` (CV_8UC1..4 or CV_16UC1..4) in a single
+// pass. Row bands run in parallel and are merged in band order, so the result
+// does not depend on scheduling. For 16-bit input `bins16` (a power of two up
+// to 65536) selects the binning.
+static void calcChannelHist(const Mat &im, ChannelHist &h, const Mat &mask = Mat(), int bins16 = 65536)
+{
+    CV_Assert(im.depth() == CV_8U || im.depth() == CV_16U);
+    CV_Assert(mask.empty() || (mask.type() == CV_8UC1 && mask.size() == im.size()));
+
+    const bool wide = im.depth() == CV_16U;
+    h.channels = im.channels();
+    h.bins = wide ? bins16 : 256;
+    h.shift = 0;
+    if (wide)
+        while ((65536 >> h.shift) > h.bins)
+            ++h.shift;
+    h.counts.assign(h.channels * h.bins, 0);
+
+    const int copies = h.bins <= 4096 ? 4 : 1;
+    const int subSize = copies * h.channels * h.bins;
+    const int bands = max(1, min(getNumThreads(), im.rows));
+    vector<int> sub(size_t(bands) * subSize, 0);
+
+    parallel_for_(Range(0, bands), [&](const Range &r)
+    {
+        for (int b = r.start; b < r.end; ++b)
+        {
+            int y0 = b * im.rows / bands, y1 = (b + 1) * im.rows / bands;
+            int *dst = &sub[size_t(b) * subSize];
+            if (wide)
+                accumulateHistBand<ushort>(im, mask, y0, y1, h.shift, h.bins, copies, dst);
+            else
+                accumulateHistBand<uchar>(im, mask, y0, y1, 0, h.bins, copies, dst);
+        }
+    });
+
+    const int stride = h.channels * h.bins;
+    for (int b = 0; b < bands; ++b)
+        for (int k = 0; k < copies; ++k)
+        {
+            const int *s = &sub[size_t(b) * subSize + k * stride];
+            for (int i = 0; i < stride; ++i)
+                h.counts[i] += s[i];
+        }
+}
+
+// Histogram of lut(image) from the histogram of image, in O(256) per channel.
+// `lut` is what cv::LUT takes: 256 entries, 1 channel or one per channel.
+static void remapChannelHist(const ChannelHist &src, const Mat &lut, ChannelHist &dst)
+{
+    CV_Assert(src.bins == 256 && lut.total() == 256 && lut.depth() == CV_8U);
+    CV_Assert(lut.channels() == 1 || lut.channels() == src.channels);
+
+    ChannelHist out;
+    out.channels = src.channels;
+    out.bins = 256;
+    out.counts.assign(src.channels * 256, 0);
+    const uchar *l = lut.ptr<uchar>();
+    const int lcn = lut.channels();
+    for (int c = 0; c < src.channels; ++c)
+    {
+        const int *s = src[c];
+        int *d = out[c];
+        const int lc = lcn == 1 ? 0 : c;
+        for (int v = 0; v < 256; ++v)
+            d[l[v * lcn + lc]] += s[v];
+    }
+    dst = out;
+}
+
+// 16-bit equalize::buildLUT: 65536 entries from a histogram of `bins` bins
+// (a power of two, binned as calcChannelHist does). The CDF rises linearly
+// across the values of each bin instead of stepping once per bin.
+static void buildEqualizeLUT16(const int *hist, int bins, int64 total, ushort *lut)
+{
+    const int width = 65536 / bins;
+    int i = 0;
+    while (i < bins && hist[i] == 0)
+        ++i;
+    if (i == bins || hist[i] == total)
+    {
+        for (int k = 0; k < 65536; ++k)
+            lut[k] = ushort(i == bins ? k : i * width);
+        return;
+    }
+    const double scale = 65535.0 / double(total - hist[i]);
+    fill(lut, lut + (i + 1) * width, ushort(0));
+    int64 sum = 0;
+    for (++i; i < bins; ++i)
+    {
+        const double base = sum * scale, slope = hist[i] * scale / width;
+        for (int k = 0; k < width; ++k)
+            lut[i * width + k] = saturate_cast<ushort>(base + slope * (k + 1));
+        sum += hist[i];
+    }
+}
+
+// Global equalization of CV_16UC1 / CV_16UC3 that stays 16-bit. The gray or
+// luma histogram is binned into `bins` levels (4096 = 12 bits is plenty for
+// the CDF and keeps the counters in cache), expanded by buildEqualizeLUT16
+// into a 65536-entry table; colour pixels get lut(Y) - Y added like
+// equalize::equalizeLuma. A gray srcHist is reused as is. outHist is
+// counted with the same binning while pass 2 writes the pixels.
+static void equalize16(Mat &im, int bins = 4096, const ChannelHist *srcHist = nullptr, ChannelHist *outHist = nullptr)
+{
+    CV_Assert(im.type() == CV_16UC1 || im.type() == CV_16UC3);
+    const int cn = im.channels(), rows = im.rows, cols = im.cols;
+    const int bands = max(1, min(getNumThreads(), rows));
+    int shift = 0;
+    while ((65536 >> shift) > bins)
+        ++shift;
+
+    vector<int> hist;
+    if (cn == 1)
+    {
+        ChannelHist own;
+        if (!srcHist || srcHist->channels != 1)
+        {
+            calcChannelHist(im, own, Mat(), bins);
+            srcHist = &own;
+        }
+        bins = srcHist->bins;
+        shift = srcHist->shift;
+        hist = srcHist->counts;
+    }
+    else
+    {
+        vector<int> bandHist(size_t(bands) * bins, 0);
+        parallel_for_(Range(0, bands), [&](const Range &r)
+        {
+            for (int b = r.start; b < r.end; ++b)
+            {
+                int *h = &bandHist[size_t(b) * bins];
+                for (int y = b * rows / bands; y < (b + 1) * rows / bands; ++y)
+                {
+                    const ushort *p = im.ptr<ushort>(y);
+                    for (int x = 0; x < cols; ++x, p += 3)
+                        ++h[equalize::lumaBGR(p) >> shift];
+                }
+            }
+        });
+        hist.assign(bins, 0);
+        for (int b = 0; b < bands; ++b)
+            for (int k = 0; k < bins; ++k)
+                hist[k] += bandHist[size_t(b) * bins + k];
+    }
+
+    vector<ushort> lut(65536);
+    buildEqualizeLUT16(&hist[0], bins, int64(rows) * cols, &lut[0]);
+
+    vector<int> outBand(outHist ? size_t(bands) * cn * bins : 0, 0);
+    parallel_for_(Range(0, bands), [&](const Range &r)
+    {
+        for (int b = r.start; b < r.end; ++b)
+        {
+            int *oh = outHist ? &outBand[size_t(b) * cn * bins] : nullptr;
+            for (int y = b * rows / bands; y < (b + 1) * rows / bands; ++y)
+            {
+                ushort *p = im.ptr<ushort>(y);
+                for (int x = 0; x < cols; ++x, p += cn)
+                {
+                    if (cn == 1)
+                        p[0] = lut[p[0]];
+                    else
+                    {
+                        const int luma = equalize::lumaBGR(p), d = lut[luma] - luma;
+                        p[0] = saturate_cast<ushort>(p[0] + d);
+                        p[1] = saturate_cast<ushort>(p[1] + d);
+                        p[2] = saturate_cast<ushort>(p[2] + d);
+                    }
+                    if (oh)
+                        for (int c = 0; c < cn; ++c)
+                            ++oh[c * bins + (p[c] >> shift)];
+                }
+            }
+        }
+    });
+
+    if (outHist)
+    {
+        outHist->channels = cn;
+        outHist->bins = bins;
+        outHist->shift = shift;
+        outHist->counts.assign(cn * bins, 0);
+        for (int b = 0; b < bands; ++b)
+            for (int i = 0; i < cn * bins; ++i)
+                outHist->counts[i] += outBand[size_t(b) * cn * bins + i];
+    }
+}
+
+// Contrast-limited adaptive equalization (CLAHE) of the luma of a BGR or
+// grayscale image. Tile histograms are built in parallel, clipped at
+// clipLimit * (tile area / 256) and the excess redistributed in O(256).
+// The interpolation pass works a row at a time over row bands: the four
+// neighbouring tile LUT entries of each pixel are gathered (scalar, they
+// are table lookups), then the fixed-point bilinear blend and, for colour,
+// adding lut(Y) - Y to B, G and R run on universal intrinsics like the
+// global equalizer. If outHist is given the result's histogram is counted
+// in the same pass.
+static void equalizeCLAHE(Mat &im, double clipLimit = 2.0, Size tiles = Size(8, 8), ChannelHist *outHist = nullptr)
+{
+    CV_Assert(im.type() == CV_8UC1 || im.type() == CV_8UC3);
+    const int cn = im.channels(), rows = im.rows, cols = im.cols;
+    const int tilesX = max(1, min(tiles.width, cols)), tilesY = max(1, min(tiles.height, rows));
+    vector<uchar> luts(size_t(tilesX) * tilesY * 256);
+
+    // --- per-tile clipped histograms -> LUTs ---
+    parallel_for_(Range(0, tilesX * tilesY), [&](const Range &r)
+    {
+        for (int t = r.start; t < r.end; ++t)
+        {
+            int tx = t % tilesX, ty = t / tilesX;
+            int x0 = tx * cols / tilesX, x1 = (tx + 1) * cols / tilesX;
+            int y0 = ty * rows / tilesY, y1 = (ty + 1) * rows / tilesY;
+            int area = (x1 - x0) * (y1 - y0);
+
+            int hist[256] = {0};
+            for (int y = y0; y < y1; ++y)
+            {
+                const uchar *p = im.ptr<uchar>(y) + x0 * cn;
+                if (cn == 3)
+                    for (int x = x0; x < x1; ++x, p += 3)
+                        ++hist[equalize::lumaBGR(p)];
+                else
+                    for (int x = x0; x < x1; ++x)
+                        ++hist[*p++];
+            }
+
+            if (clipLimit > 0.0)
+            {
+                int clip = max(1, int(clipLimit * area / 256));
+                int excess = 0;
+                for (int i = 0; i < 256; ++i)
+                    if (hist[i] > clip)
+                    {
+                        excess += hist[i] - clip;
+                        hist[i] = clip;
+                    }
+                int batch = excess / 256, residual = excess - batch * 256;
+                for (int i = 0; i < 256; ++i)
+                    hist[i] += batch;
+                if (residual > 0)
+                {
+                    int step = max(256 / residual, 1);
+                    for (int i = 0; i < 256 && residual > 0; i += step, --residual)
+                        ++hist[i];
+                }
+            }
+
+            uchar *lut = &luts[size_t(t) * 256];
+            float scale = 255.0f / area;
+            int sum = 0;
+            for (int i = 0; i < 256; ++i)
+            {
+                sum += hist[i];
+                lut[i] = saturate_cast<uchar>(sum * scale);
+            }
+        }
+    });
+
+    // --- bilinear blend of neighbouring tile LUTs ---
+    // column offsets into a row of tile LUTs and 8-bit blend weights, the
+    // weights also as (256 - wx, wx) pairs for v_dotprod
+    const float tileW = float(cols) / tilesX, tileH = float(rows) / tilesY;
+    vector<int> ind1(cols), ind2(cols);
+    vector<short> wx(2 * cols);
+    for (int x = 0; x < cols; ++x)
+    {
+        float txf = x / tileW - 0.5f;
+        int tx1 = cvFloor(txf);
+        int tx2 = tx1 + 1;
+        int w = cvRound((txf - tx1) * 256);
+        wx[2 * x] = short(256 - w);
+        wx[2 * x + 1] = short(w);
+        ind1[x] = max(tx1, 0) * 256;
+        ind2[x] = min(tx2, tilesX - 1) * 256;
+    }
+
+    const int bands = max(1, min(getNumThreads(), rows));
+    vector<int> outBand(outHist ? bands * cn * 256 : 0, 0);
+    parallel_for_(Range(0, bands), [&](const Range &r)
+    {
+        vector<uchar> luma(cols);
+        // gathered LUT entries: top-left, top-right, bottom-left, bottom-right
+        vector<short> g[4] = {vector<short>(cols), vector<short>(cols), vector<short>(cols), vector<short>(cols)};
+        vector<short> v(cols);
+        for (int b = r.start; b < r.end; ++b)
+        {
+            int *oh = outHist ? &outBand[b * cn * 256] : nullptr;
+            for (int y = b * rows / bands; y < (b + 1) * rows / bands; ++y)
+            {
+                float tyf = y / tileH - 0.5f;
+                int ty1 = cvFloor(tyf);
+                int ty2 = ty1 + 1;
+                int wy = cvRound((tyf - ty1) * 256);
+                const uchar *lutRow1 = &luts[size_t(max(ty1, 0)) * tilesX * 256];
+                const uchar *lutRow2 = &luts[size_t(min(ty2, tilesY - 1)) * tilesX * 256];
+
+                uchar *p = im.ptr<uchar>(y);
+                const uchar *l = p;
+                if (cn == 3)
+                {
+                    equalize::lumaRow(p, cols, &luma[0]);
+                    l = &luma[0];
+                }
+                for (int x = 0; x < cols; ++x)
+                {
+                    g[0][x] = lutRow1[ind1[x] + l[x]];
+                    g[1][x] = lutRow1[ind2[x] + l[x]];
+                    g[2][x] = lutRow2[ind1[x] + l[x]];
+                    g[3][x] = lutRow2[ind2[x] + l[x]];
+                }
+
+                // v = blended value (gray) or blended value - Y (colour)
+                int x = 0;
+#if CV_SIMD
+                const int half = CV_SIMD_WIDTH / 2; // pixels per v_int16
+                const v_int32 wTop = vx_setall_s32(256 - wy), wBot = vx_setall_s32(wy);
+                const v_int32 bias = vx_setall_s32(1 << 15);
+                for (; x <= cols - half; x += half)
+                {
+                    // (left, right) pairs against (256 - wx, wx)
+                    v_int16 tl[2], bl[2];
+                    v_zip(vx_load(&g[0][x]), vx_load(&g[1][x]), tl[0], tl[1]);
+                    v_zip(vx_load(&g[2][x]), vx_load(&g[3][x]), bl[0], bl[1]);
+                    v_int32 res[2];
+                    for (int h = 0; h < 2; ++h)
+                    {
+                        const v_int16 w = vx_load(&wx[2 * x + h * half]);
+                        res[h] = (v_dotprod(tl[h], w) * wTop + v_dotprod(bl[h], w) * wBot + bias) >> 16;
+                    }
+                    v_int16 out = v_pack(res[0], res[1]);
+                    if (cn == 3)
+                        out = out - v_reinterpret_as_s16(vx_load_expand(l + x));
+                    v_store(&v[x], out);
+                }
+#endif
+                for (; x < cols; ++x)
+                {
+                    int top = g[0][x] * wx[2 * x] + g[1][x] * wx[2 * x + 1];
+                    int bot = g[2][x] * wx[2 * x] + g[3][x] * wx[2 * x + 1];
+                    int res = (top * (256 - wy) + bot * wy + (1 << 15)) >> 16;
+                    v[x] = short(cn == 3 ? res - l[x] : res);
+                }
+
+                if (cn == 1)
+                {
+                    x = 0;
+#if CV_SIMD
+                    for (; x <= cols - CV_SIMD_WIDTH; x += CV_SIMD_WIDTH)
+                        v_store(p + x, v_pack_u(vx_load(&v[x]), vx_load(&v[x + CV_SIMD_WIDTH / 2])));
+#endif
+                    for (; x < cols; ++x)
+                        p[x] = uchar(v[x]);
+                    if (oh)
+                        for (x = 0; x < cols; ++x)
+                            ++oh[p[x]];
+                    continue;
+                }
+                equalize::addDeltaRow(p, &v[0], cols);
+                if (oh)
+                    for (x = 0; x < cols; ++x, p += 3)
+                        ++oh[p[0]], ++oh[256 + p[1]], ++oh[512 + p[2]];
+            }
+        }
+    });
+
+    if (outHist)
+    {
+        outHist->channels = cn;
+        outHist->bins = 256;
+        outHist->shift = 0;
+        outHist->counts.assign(cn * 256, 0);
+        for (int b = 0; b < bands; ++b)
+            for (int i = 0; i < cn * 256; ++i)
+                outHist->counts[i] += outBand[b * cn * 256 + i];
+    }
+}
+
+// Equalize image in Y channel (works for color and grayscale, 8 or 16 bit).
+// srcHist, if known, saves recounting a grayscale input; eqHist receives the
+// histogram of the result without another pass over the image.
+static void equalizeHistogram(Mat &im, const ChannelHist *srcHist = nullptr, ChannelHist *eqHist = nullptr)
 {
     if (im.empty())
         return;
+    if (im.depth() == CV_16U)
+    {
+        equalize16(im, srcHist ? srcHist->bins : 4096, srcHist, eqHist);
+        return;
+    }
     if (im.channels() == 1)
     {
-        equalizeHist(im, im);
+        ChannelHist own;
+        if (!srcHist)
+        {
+            calcChannelHist(im, own);
+            srcHist = &own;
+        }
+        Mat lut(1, 256, CV_8UC1);
+        equalize::buildLUT((*srcHist)[0], int(im.total()), lut.ptr<uchar>());
+        LUT(im, lut, im);
+        if (eqHist)
+            remapChannelHist(*srcHist, lut, *eqHist);
         return;
     }
-    Mat ycrcb;
-    cvtColor(im, ycrcb, COLOR_BGR2YCrCb);
-    vector<Mat> channels;
-    split(ycrcb, channels);
-    equalizeHist(channels[0], channels[0]);
-    merge(channels, ycrcb);
-    cvtColor(ycrcb, im, COLOR_YCrCb2BGR);
+    if (eqHist)
+    {
+        eqHist->channels = 3;
+        eqHist->bins = 256;
+        eqHist->shift = 0;
+        eqHist->counts.resize(3 * 256);
+    }
+    equalize::equalizeLuma(im, eqHist ? &eqHist->counts[0] : nullptr);
 }
 
-static Mat drawColorHistImage(const Mat &image)
+static Mat drawColorHistImage(const ChannelHist &h)
 {
-    vector<Mat> bgr_planes;
-    split(image, bgr_planes);
-
-    int histSize = 256;
-    float range[] = {0, 256};
-    const float *histRange = {range};
-    bool uniform = true, accumulate = false;
-
     vector<Mat> hists(3);
     for (int i = 0; i < 3; ++i)
     {
-        calcHist(&bgr_planes[i], 1, nullptr, Mat(), hists[i], 1, &histSize, &histRange, uniform, accumulate);
+        Mat(1, h.bins, CV_32SC1, const_cast<int *>(h[min(i, h.channels - 1)])).convertTo(hists[i], CV_32F);
+        if (h.bins != 256)
+            resize(hists[i], hists[i], Size(256, 1), 0, 0, INTER_AREA);
         normalize(hists[i], hists[i], 0, 100, NORM_MINMAX);
     }
 
@@ -93,45 +667,297 @@ static Mat drawColorHistImage(const Mat &image)
     return histImage;
 }
 
-int main()
+static Mat drawColorHistImage(const Mat &image)
+{
+    ChannelHist h;
+    calcChannelHist(image, h);
+    return drawColorHistImage(h);
+}
+
+// Equalize one image and build the side-by-side histogram display.
+// equalizeSec, if given, receives the time of the equalization call alone.
+static void processImage(const Mat &im, bool useClahe, Mat &imEqualized, Mat &histDisplay,
+                         double *equalizeSec = nullptr)
+{
+    // Original image histogram (colored), 16-bit input binned to 12 bits
+    ChannelHist origHist;
+    calcChannelHist(im, origHist, Mat(), 4096);
+    Mat origHistDisplay = drawColorHistImage(origHist);
+
+    // Histogram equalization, its histogram comes out of the same pass.
+    // CLAHE is 8-bit only, 16-bit images get the global equalizer.
+    imEqualized = im.clone();
+    ChannelHist eqHist;
+    int64 t0 = getTickCount();
+    if (useClahe && im.depth() == CV_8U)
+        equalizeCLAHE(imEqualized, 2.0, Size(8, 8), &eqHist);
+    else
+        equalizeHistogram(imEqualized, &origHist, &eqHist);
+    if (equalizeSec)
+        *equalizeSec = (getTickCount() - t0) / getTickFrequency();
+
+    // Equalized histogram (colored)
+    Mat eqHistDisplay = drawColorHistImage(eqHist);
+
+    histDisplay.create(300, 256 * 2, CV_8UC3);
+    origHistDisplay.copyTo(histDisplay(Rect(0, 0, 256, 300)));
+    eqHistDisplay.copyTo(histDisplay(Rect(256, 0, 256, 300)));
+    putText(histDisplay, "Eredeti hiszt.", Point(10, 30), FONT_HERSHEY_SIMPLEX, 0.8, Scalar(0, 0, 0), 2);
+    putText(histDisplay, "Kiegy. hiszt.", Point(256 + 10, 30), FONT_HERSHEY_SIMPLEX, 0.8, Scalar(0, 0, 0), 2);
+}
+
+// ---------- Batch mode ----------
+// Fixed-capacity FIFO between pipeline stages. push blocks while full, pop
+// blocks while empty and returns false once the queue is closed and drained.
+template <typename T>
+class BoundedQueue
+{
+public:
+    explicit BoundedQueue(size_t capacity) : capacity(capacity) {}
+
+    void push(T item)
+    {
+        unique_lock<mutex> lock(m);
+        notFull.wait(lock, [&] { return items.size() < capacity; });
+        items.push_back(std::move(item));
+        notEmpty.notify_one();
+    }
+
+    bool pop(T &item)
+    {
+        unique_lock<mutex> lock(m);
+        notEmpty.wait(lock, [&] { return !items.empty() || closed; });
+        if (items.empty())
+            return false;
+        item = std::move(items.front());
+        items.pop_front();
+        notFull.notify_one();
+        return true;
+    }
+
+    void close()
+    {
+        lock_guard<mutex> lock(m);
+        closed = true;
+        notEmpty.notify_all();
+    }
+
+private:
+    size_t capacity;
+    deque<T> items;
+    bool closed = false;
+    mutex m;
+    condition_variable notFull, notEmpty;
+};
+
+struct BatchJob
+{
+    int index = 0;
+    string name;
+    Mat image;
+    Mat histDisplay;
+};
+
+// Busy time of one pipeline stage, summed over its threads
+struct StageTimer
+{
+    atomic<int64> ticks{0};
+    int threads = 1;
+
+    double utilisation(double wallSec) const
+    {
+        return 100.0 * ticks / getTickFrequency() / (wallSec * threads);
+    }
+};
+
+static string outputStem(const string &name)
+{
+    size_t slash = name.find_last_of("/\\");
+    string base = slash == string::npos ? name : name.substr(slash + 1);
+    size_t dot = base.find_last_of('.');
+    return dot == string::npos ? base : base.substr(0, dot);
+}
+
+// Decode -> equalize -> encode with the stages overlapping. Decoders and
+// equalization workers run in parallel, a single encoder writes results in
+// input order (out-of-order arrivals wait in a small reorder buffer).
+// Decoders only start image i once i < nextOut + window, so one slow image
+// cannot make the reorder buffer grow: at most `window` images are in
+// flight across the queues, the workers and the buffer. Throughput
+// is set by the slowest stage; the per-stage utilisation printed at the end
+// shows which one that is.
+static void runBatch(const vector<string> &files, double scale, Size fit, bool useClahe)
+{
+    const int hw = max(2, int(thread::hardware_concurrency()));
+    StageTimer decodeTime, computeTime, encodeTime;
+    decodeTime.threads = 2;
+    computeTime.threads = max(1, hw - 3);
+    encodeTime.threads = 1;
+
+    BoundedQueue<BatchJob> decoded(4), processed(4);
+    const int window = 2 * computeTime.threads + 4;
+    mutex orderMutex;
+    condition_variable orderMoved;
+    int nextOut = 0; // first image not yet written, guarded by orderMutex
+    atomic<int> nextFile{0};
+    atomic<int> decodersLeft{decodeTime.threads}, workersLeft{computeTime.threads};
+    int64 start = getTickCount();
+
+    vector<thread> pool;
+    for (int t = 0; t < decodeTime.threads; ++t)
+        pool.emplace_back([&]
+        {
+            for (int i = nextFile++; i < int(files.size()); i = nextFile++)
+            {
+                {
+                    unique_lock<mutex> lock(orderMutex);
+                    orderMoved.wait(lock, [&] { return i < nextOut + window; });
+                }
+                int64 t0 = getTickCount();
+                BatchJob job;
+                job.index = i;
+                job.name = files[i];
+                job.image = loadPreview(files[i], scale, fit);
+                decodeTime.ticks += getTickCount() - t0;
+                decoded.push(std::move(job));
+            }
+            if (--decodersLeft == 0)
+                decoded.close();
+        });
+
+    for (int t = 0; t < computeTime.threads; ++t)
+        pool.emplace_back([&]
+        {
+            BatchJob job;
+            while (decoded.pop(job))
+            {
+                int64 t0 = getTickCount();
+                if (!job.image.empty())
+                {
+                    Mat eq;
+                    processImage(job.image, useClahe, eq, job.histDisplay);
+                    job.image = eq;
+                }
+                computeTime.ticks += getTickCount() - t0;
+                processed.push(std::move(job));
+            }
+            if (--workersLeft == 0)
+                processed.close();
+        });
+
+    // encoder: writes <stem>_eq.jpg (.png for 16-bit) and <stem>_hist.png in input order
+    pool.emplace_back([&]
+    {
+        map<int, BatchJob> pending;
+        int next = 0;
+        BatchJob job;
+        while (processed.pop(job))
+        {
+            pending[job.index] = std::move(job);
+            for (auto it = pending.find(next); it != pending.end(); it = pending.find(next))
+            {
+                int64 t0 = getTickCount();
+                const BatchJob &done = it->second;
+                if (done.image.empty())
+                    cerr << "Hiba: Nem találom a " << done.name << " fájlt!" << endl;
+                else
+                {
+                    string stem = outputStem(done.name);
+                    imwrite(stem + (done.image.depth() == CV_16U ? "_eq.png" : "_eq.jpg"), done.image);
+                    imwrite(stem + "_hist.png", done.histDisplay);
+                    cout << "[" << done.index + 1 << "/" << files.size() << "] " << stem << endl;
+                }
+                pending.erase(it);
+                encodeTime.ticks += getTickCount() - t0;
+                {
+                    lock_guard<mutex> lock(orderMutex);
+                    nextOut = ++next;
+                }
+                orderMoved.notify_all();
+            }
+        }
+    });
+
+    for (auto &t : pool)
+        t.join();
+
+    double wall = (getTickCount() - start) / getTickFrequency();
+    cout << files.size() << " images in " << wall << " s ("
+         << files.size() / wall << " img/s)" << endl;
+    cout << "  decode  x" << decodeTime.threads << ": " << decodeTime.utilisation(wall) << "% busy" << endl;
+    cout << "  process x" << computeTime.threads << ": " << computeTime.utilisation(wall) << "% busy" << endl;
+    cout << "  encode  x" << encodeTime.threads << ": " << encodeTime.utilisation(wall) << "% busy" << endl;
+}
+
+int main(int argc, char **argv)
 {
     vector<string> imageFiles = {"cheguevara.jpg", "japan.jpg", "muzeum.jpg", "oroszlan.jpg"};
 
+    // Optional arguments:
+    //   a number  - preview scale, e.g. "./Lab5 0.25" decodes at a quarter of the size
+    //   WxH       - fit into W x H instead, e.g. "./Lab5 1280x720"; the size is
+    //               read from the file header so JPEGs decode reduced
+    //   clahe     - adaptive (CLAHE) instead of global equalization
+    //   batch     - no windows: run the decode/equalize/encode pipeline and
+    //               write <name>_eq.jpg (.png if 16-bit) and <name>_hist.png for every image
+    //   anything else is taken as an image file and replaces the default list
+    double previewScale = 1.0;
+    Size previewFit;
+    bool useClahe = false, batch = false;
+    vector<string> userFiles;
+    for (int i = 1; i < argc; ++i)
+    {
+        string arg = argv[i];
+        char *end = nullptr;
+        double value = strtod(argv[i], &end);
+        int w = 0, h = 0;
+        char tail = 0;
+        if (arg == "clahe")
+            useClahe = true;
+        else if (arg == "batch")
+            batch = true;
+        else if (end != argv[i] && *end == '\0')
+            previewScale = value;
+        else if (sscanf(argv[i], "%dx%d%c", &w, &h, &tail) == 2 && w > 0 && h > 0)
+            previewFit = Size(w, h);
+        else
+            userFiles.push_back(arg);
+    }
+    if (previewScale <= 0.0)
+        previewScale = 1.0;
+    if (!userFiles.empty())
+        imageFiles = userFiles;
+
+    if (batch)
+    {
+        runBatch(imageFiles, previewScale, previewFit, useClahe);
+        return 0;
+    }
+
     for (const auto &imageFile : imageFiles)
     {
-        Mat im = loadImage(imageFile);
+        Mat im = loadPreview(imageFile, previewScale, previewFit);
         if (im.empty())
         {
             cerr << "Hiba: Nem találom a " << imageFile << " fájlt!" << endl;
             continue;
         }
 
-        // Original image histogram (colored)
-        Mat origHistDisplay = drawColorHistImage(im);
-
-        // Histogram equalization
-        Mat imEqualized = im.clone();
-        equalizeHistogram(imEqualized);
-
-        // Equalized histogram (colored)
-        Mat eqHistDisplay = drawColorHistImage(imEqualized);
+        Mat imEqualized, histDisplay;
+        double sec = 0;
+        processImage(im, useClahe, imEqualized, histDisplay, &sec);
+        if (useClahe && im.depth() == CV_8U)
+            cout << imageFile << ": CLAHE " << im.total() / 1e6 / sec << " MP/s" << endl;
 
         // Create image display
         Mat imageDisplay(im.rows, im.cols * 2, im.type());
         im.copyTo(imageDisplay(Rect(0, 0, im.cols, im.rows)));
         imEqualized.copyTo(imageDisplay(Rect(im.cols, 0, im.cols, im.rows)));
 
-        // Create histogram display
-        Mat histDisplay(300, 256 * 2, CV_8UC3, Scalar(255, 255, 255));
-        origHistDisplay.copyTo(histDisplay(Rect(0, 0, 256, 300)));
-        eqHistDisplay.copyTo(histDisplay(Rect(256, 0, 256, 300)));
-
-        // Add labels to images
-        putText(imageDisplay, "Eredeti kep", Point(10, 30), FONT_HERSHEY_SIMPLEX, 1, Scalar(255, 255, 255), 2);
-        putText(imageDisplay, "Kiegyenlitett kep", Point(im.cols + 10, 30), FONT_HERSHEY_SIMPLEX, 1, Scalar(255, 255, 255), 2);
-
-        putText(histDisplay, "Eredeti hiszt.", Point(10, 30), FONT_HERSHEY_SIMPLEX, 0.8, Scalar(0, 0, 0), 2);
-        putText(histDisplay, "Kiegy. hiszt.", Point(256 + 10, 30), FONT_HERSHEY_SIMPLEX, 0.8, Scalar(0, 0, 0), 2);
+        // Add labels to images (white is 65535 in 16-bit images)
+        const Scalar white = Scalar::all(im.depth() == CV_16U ? 65535 : 255);
+        putText(imageDisplay, "Eredeti kep", Point(10, 30), FONT_HERSHEY_SIMPLEX, 1, white, 2);
+        putText(imageDisplay, "Kiegyenlitett kep", Point(im.cols + 10, 30), FONT_HERSHEY_SIMPLEX, 1, white, 2);
 
         imshow("Kepek", imageDisplay);
         imshow("Hisztogramok", histDisplay);
@@ -147,4 +973,4 @@ int main()
         }
     }
     return 0;
-}
\ No newline at end of file
+}
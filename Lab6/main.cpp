@@ -1,4 +1,11 @@
 #include <opencv2/opencv.hpp>
+#include <opencv2/core/hal/intrin.hpp>
+#include "../Synth/synth.hpp"
+#include <functional>
+#include <cstdint>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
 using namespace cv;
 using namespace std;
 
@@ -18,6 +25,964 @@ bool showAndWait(const string &win, const Mat &img)
     return true;
 }
 
+// ---------- Fast rectangular morphology (van Herk / Gil-Werman) ----------
+// Min/max over a window of k pixels costs 3 comparisons per pixel whatever k
+// is: the padded signal is cut into blocks of k, g is the running extreme from
+// each block start, h the running extreme to each block end, and every window
+// [x, x + k) spans one block boundary, so its extreme is op(h[x], g[x + k - 1]).
+// Outside the image the neutral value is used (255 for min, 0 for max), which
+// is the border erode/dilate use by default.
+// Min/max is per byte, so interleaved colour needs no channel split: every
+// pass runs on whole rows of bytes, CV_SIMD_WIDTH (16/32/64) at a time.
+struct MinOp
+{
+    enum { neutral = 255 };
+    static uchar apply(uchar a, uchar b) { return a < b ? a : b; }
+#if CV_SIMD
+    static v_uint8 apply(const v_uint8 &a, const v_uint8 &b) { return v_min(a, b); }
+#endif
+};
+
+struct MaxOp
+{
+    enum { neutral = 0 };
+    static uchar apply(uchar a, uchar b) { return a > b ? a : b; }
+#if CV_SIMD
+    static v_uint8 apply(const v_uint8 &a, const v_uint8 &b) { return v_max(a, b); }
+#endif
+};
+
+// placeholder for the unused second image of the two-image passes
+struct NoOp
+{
+    enum { neutral = 0 };
+    static uchar apply(uchar a, uchar) { return a; }
+#if CV_SIMD
+    static v_uint8 apply(const v_uint8 &a, const v_uint8 &) { return a; }
+#endif
+};
+
+// d[x] = op(a[x], b[x]) for n bytes
+template <class Op>
+static void applyRow(const uchar *a, const uchar *b, uchar *d, int n)
+{
+    int x = 0;
+#if CV_SIMD
+    for (; x <= n - CV_SIMD_WIDTH; x += CV_SIMD_WIDTH)
+        v_store(d + x, Op::apply(vx_load(a + x), vx_load(b + x)));
+#endif
+    for (; x < n; ++x)
+        d[x] = Op::apply(a[x], b[x]);
+}
+
+// One padded grayscale line p of m pixels (m a multiple of k): g/h
+// recurrences and the k-wide window result for the first n pixels into d.
+template <class Op>
+static void vhgwLine(const uchar *p, uchar *g, uchar *h, uchar *d, int m, int n, int k)
+{
+    for (int s = 0; s < m; s += k)
+    {
+        int e = s + k;
+        g[s] = p[s];
+        for (int j = s + 1; j < e; ++j)
+            g[j] = Op::apply(g[j - 1], p[j]);
+        h[e - 1] = p[e - 1];
+        for (int j = e - 2; j >= s; --j)
+            h[j] = Op::apply(h[j + 1], p[j]);
+    }
+    applyRow<Op>(h, g + k - 1, d, n);
+}
+
+// g/h buffers of one column strip for a window of k rows: whole row segments
+// are combined at once, so the inner loops run across columns in SIMD
+template <class Op, class RowFn>
+static void vhgwStrip(RowFn row, uchar *g, uchar *h, int m, int k, int w, int strip)
+{
+    for (int b = 0; b < m; b += k)
+    {
+        memcpy(&g[size_t(b) * strip], row(b), w);
+        for (int i = b + 1; i < b + k; ++i)
+        {
+            uchar *gi = &g[size_t(i) * strip];
+            applyRow<Op>(gi - strip, row(i), gi, w);
+        }
+        memcpy(&h[size_t(b + k - 1) * strip], row(b + k - 1), w);
+        for (int i = b + k - 2; i >= b; --i)
+        {
+            uchar *hi = &h[size_t(i) * strip];
+            applyRow<Op>(hi + strip, row(i), hi, w);
+        }
+    }
+}
+
+// Colour tiles for the horizontal pass: a band of up to 16 rows is transposed
+// so that tile line x holds pixel x of every row, each padded to 4 bytes
+// (B, G, R and a spare byte). A window along x is then a window over tile
+// lines, filtered like the vertical pass with one 64-byte line per min/max.
+enum
+{
+    TILE_PIXEL = 4,                    // bytes per padded pixel
+    TILE_LINE = 64,                    // bytes per tile line
+    TILE_ROWS = TILE_LINE / TILE_PIXEL // image rows per tile
+};
+
+// Rows [y0, y0 + t) of src through the tile; the pad lines and spare bytes of
+// `tile` hold Op::neutral and are never written, so they stay neutral
+template <class Op>
+static void vhgwTile(const Mat &src, Mat &dst, int y0, int t, int k, int anchor, int m,
+                     uchar *tile, uchar *g, uchar *h, uchar *res)
+{
+    const int cn = src.channels(), n = src.cols;
+    for (int j = 0; j < t; ++j)
+    {
+        const uchar *p = src.ptr<uchar>(y0 + j);
+        uchar *q = tile + size_t(anchor) * TILE_LINE + j * TILE_PIXEL;
+        for (int x = 0; x < n; ++x, p += cn, q += TILE_LINE)
+            for (int c = 0; c < cn; ++c)
+                q[c] = p[c];
+    }
+    vhgwStrip<Op>([&](int i) -> const uchar * { return tile + size_t(i) * TILE_LINE; },
+                  g, h, m, k, TILE_LINE, TILE_LINE);
+    applyRow<Op>(h, g + size_t(k - 1) * TILE_LINE, res, n * TILE_LINE);
+    for (int j = 0; j < t; ++j)
+    {
+        uchar *d = dst.ptr<uchar>(y0 + j);
+        const uchar *q = res + j * TILE_PIXEL;
+        for (int x = 0; x < n; ++x, d += cn, q += TILE_LINE)
+            for (int c = 0; c < cn; ++c)
+                d[c] = q[c];
+    }
+}
+
+// Window [x - anchor, x - anchor + k) along x, for one image or, with OpB and
+// srcB/dstB, for two images in the same row loop. Grayscale runs the g/h
+// recurrences along each row; colour goes through the transposed tiles, as
+// a recurrence stepping over interleaved pixels would not vectorise.
+template <class OpA, class OpB = NoOp>
+static void vhgwHorizontal(const Mat &srcA, Mat &dstA, int k, int anchor,
+                           const Mat *srcB = nullptr, Mat *dstB = nullptr)
+{
+    const int cn = srcA.channels(), n = srcA.cols;
+    const int m = (n + k - 1 + k - 1) / k * k;
+    if (cn == 1)
+    {
+        parallel_for_(Range(0, srcA.rows), [&](const Range &r)
+        {
+            vector<uchar> pa(m, OpA::neutral), g(m), h(m), pb;
+            if (srcB)
+                pb.assign(m, OpB::neutral);
+            for (int y = r.start; y < r.end; ++y)
+            {
+                memcpy(&pa[anchor], srcA.ptr<uchar>(y), n);
+                vhgwLine<OpA>(&pa[0], &g[0], &h[0], dstA.ptr<uchar>(y), m, n, k);
+                if (srcB)
+                {
+                    memcpy(&pb[anchor], srcB->ptr<uchar>(y), n);
+                    vhgwLine<OpB>(&pb[0], &g[0], &h[0], dstB->ptr<uchar>(y), m, n, k);
+                }
+            }
+        });
+        return;
+    }
+
+    CV_Assert(cn <= TILE_PIXEL);
+    parallel_for_(Range(0, (srcA.rows + TILE_ROWS - 1) / TILE_ROWS), [&](const Range &r)
+    {
+        const size_t size = size_t(m) * TILE_LINE;
+        vector<uchar> ta(size, OpA::neutral), tb, g(size), h(size), res(size_t(n) * TILE_LINE);
+        if (srcB)
+            tb.assign(size, OpB::neutral);
+        for (int b = r.start; b < r.end; ++b)
+        {
+            const int y0 = b * TILE_ROWS, t = min(int(TILE_ROWS), srcA.rows - y0);
+            vhgwTile<OpA>(srcA, dstA, y0, t, k, anchor, m, &ta[0], &g[0], &h[0], &res[0]);
+            if (srcB)
+                vhgwTile<OpB>(*srcB, *dstB, y0, t, k, anchor, m, &tb[0], &g[0], &h[0], &res[0]);
+        }
+    });
+}
+
+// Window along y over 512-byte column strips run in parallel. The strips
+// keep each row access contiguous; the g/h buffers still hold the full
+// height (m * 512 bytes each), so they are not cache-sized for tall images.
+// Results are not stored here: every finished row
+// segment goes to emit(y, x0, w, resA, resB), which can write it out or
+// combine it straight away. With srcB (and its OpB), a second image is
+// filtered in the same sweep and resB is its result.
+template <class OpA, class OpB, class Emit>
+static void vhgwVertical(const Mat &srcA, const Mat *srcB, int k, int anchor, Emit emit)
+{
+    const int width = srcA.cols * srcA.channels(), n = srcA.rows;
+    const int m = (n + k - 1 + k - 1) / k * k;
+    const int strip = 512;
+    parallel_for_(Range(0, (width + strip - 1) / strip), [&](const Range &r)
+    {
+        const size_t bufSize = size_t(m) * strip;
+        vector<uchar> ga(bufSize), ha(bufSize), gb(srcB ? bufSize : 0), hb(srcB ? bufSize : 0);
+        vector<uchar> neutralA(strip, OpA::neutral), neutralB(strip, srcB ? OpB::neutral : 0);
+        vector<uchar> resA(strip), resB(strip);
+        for (int s = r.start; s < r.end; ++s)
+        {
+            const int x0 = s * strip, w = min(strip, width - x0);
+            auto rowOf = [&](const Mat &src, const vector<uchar> &neutral)
+            {
+                return [&, x0](int i) -> const uchar *
+                {
+                    int y = i - anchor;
+                    return y >= 0 && y < n ? src.ptr<uchar>(y) + x0 : &neutral[0];
+                };
+            };
+            vhgwStrip<OpA>(rowOf(srcA, neutralA), &ga[0], &ha[0], m, k, w, strip);
+            if (srcB)
+                vhgwStrip<OpB>(rowOf(*srcB, neutralB), &gb[0], &hb[0], m, k, w, strip);
+
+            for (int y = 0; y < n; ++y)
+            {
+                const size_t lo = size_t(y) * strip, hi = size_t(y + k - 1) * strip;
+                applyRow<OpA>(&ha[lo], &ga[hi], &resA[0], w);
+                if (srcB)
+                    applyRow<OpB>(&hb[lo], &gb[hi], &resB[0], w);
+                emit(y, x0, w, &resA[0], &resB[0]);
+            }
+        }
+    });
+}
+
+// Erode (MORPH_ERODE) or dilate (MORPH_DILATE) an 8-bit 1- or 3-channel image
+// with a ksize rectangle, `iterations` times. A chain of n identical
+// rectangle ops equals one op with an n * (k - 1) + 1 rectangle (anchored at
+// n * (k / 2), which matters for even k), so the chain is folded and costs the
+// same as a single pass.
+static void rectMorph(const Mat &src, Mat &dst, int op, Size ksize, int iterations = 1)
+{
+    CV_Assert(src.depth() == CV_8U && (src.channels() == 1 || src.channels() == 3));
+    CV_Assert(op == MORPH_ERODE || op == MORPH_DILATE);
+    const int kw = iterations * (ksize.width - 1) + 1;
+    const int kh = iterations * (ksize.height - 1) + 1;
+    const int ax = iterations * (ksize.width / 2), ay = iterations * (ksize.height / 2);
+
+    Mat tmp(src.size(), src.type()), out(src.size(), src.type());
+    auto store = [&](int y, int x0, int w, const uchar *res, const uchar *)
+    {
+        memcpy(out.ptr<uchar>(y) + x0, res, w);
+    };
+    if (op == MORPH_ERODE)
+    {
+        vhgwHorizontal<MinOp>(src, tmp, kw, ax);
+        vhgwVertical<MinOp, NoOp>(tmp, nullptr, kh, ay, store);
+    }
+    else
+    {
+        vhgwHorizontal<MaxOp>(src, tmp, kw, ax);
+        vhgwVertical<MaxOp, NoOp>(tmp, nullptr, kh, ay, store);
+    }
+    dst = out;
+}
+
+// ---------- Fused gradient / top-hat / black-hat ----------
+enum
+{
+    MORPH_OUT_MIN = 1,      // erosion
+    MORPH_OUT_MAX = 2,      // dilation
+    MORPH_OUT_GRADIENT = 4, // dilation - erosion
+    MORPH_OUT_TOPHAT = 8,   // src - opening
+    MORPH_OUT_BLACKHAT = 16 // closing - src
+};
+
+struct MorphOutputs
+{
+    Mat minimum, maximum, gradient, tophat, blackhat;
+};
+
+// morphologyEx for a ksize rectangle, writing every output in `which` from
+// shared sweeps instead of separate erode/dilate/subtract passes. Pass 1 takes
+// the windowed min and max of src in one sweep and writes the gradient as the
+// rows finish. Pass 2 (top-hat/black-hat only) dilates the min image and
+// erodes the max image in one sweep and subtracts from src on the way out.
+static void rectMorphFused(const Mat &src, Size ksize, int which, MorphOutputs &out)
+{
+    CV_Assert(src.depth() == CV_8U && (src.channels() == 1 || src.channels() == 3));
+    const int kw = ksize.width, kh = ksize.height, ax = kw / 2, ay = kh / 2;
+    const bool tophat = which & MORPH_OUT_TOPHAT, blackhat = which & MORPH_OUT_BLACKHAT;
+    const bool needMin = which & (MORPH_OUT_MIN | MORPH_OUT_GRADIENT) || tophat;
+    const bool needMax = which & (MORPH_OUT_MAX | MORPH_OUT_GRADIENT) || blackhat;
+    const bool keepMin = which & MORPH_OUT_MIN || tophat;
+    const bool keepMax = which & MORPH_OUT_MAX || blackhat;
+
+    Mat mn, mx, gradient;
+    if (keepMin)
+        mn.create(src.size(), src.type());
+    if (keepMax)
+        mx.create(src.size(), src.type());
+    if (which & MORPH_OUT_GRADIENT)
+        gradient.create(src.size(), src.type());
+
+    // pass 1: erosion and dilation of src
+    Mat ha(src.size(), src.type()), hb(src.size(), src.type());
+    auto emit1 = [&](int y, int x0, int w, const uchar *lo, const uchar *hi)
+    {
+        if (keepMin)
+            memcpy(mn.ptr<uchar>(y) + x0, lo, w);
+        if (keepMax)
+            memcpy(mx.ptr<uchar>(y) + x0, hi, w);
+        if (!gradient.empty())
+        {
+            uchar *g = gradient.ptr<uchar>(y) + x0;
+            for (int x = 0; x < w; ++x)
+                g[x] = uchar(hi[x] - lo[x]);
+        }
+    };
+    if (needMin && needMax)
+    {
+        vhgwHorizontal<MinOp, MaxOp>(src, ha, kw, ax, &src, &hb);
+        vhgwVertical<MinOp, MaxOp>(ha, &hb, kh, ay, emit1);
+    }
+    else if (needMin)
+    {
+        vhgwHorizontal<MinOp>(src, ha, kw, ax);
+        vhgwVertical<MinOp, NoOp>(ha, nullptr, kh, ay, [&](int y, int x0, int w, const uchar *lo, const uchar *)
+        {
+            emit1(y, x0, w, lo, lo);
+        });
+    }
+    else if (needMax)
+    {
+        vhgwHorizontal<MaxOp>(src, hb, kw, ax);
+        vhgwVertical<MaxOp, NoOp>(hb, nullptr, kh, ay, [&](int y, int x0, int w, const uchar *hi, const uchar *)
+        {
+            emit1(y, x0, w, hi, hi);
+        });
+    }
+
+    // pass 2: opening = dilate(min), closing = erode(max), subtracted in place
+    Mat th, bh;
+    if (tophat)
+        th.create(src.size(), src.type());
+    if (blackhat)
+        bh.create(src.size(), src.type());
+    auto emitTop = [&](int y, int x0, int w, const uchar *opened)
+    {
+        const uchar *s = src.ptr<uchar>(y) + x0;
+        uchar *d = th.ptr<uchar>(y) + x0;
+        for (int x = 0; x < w; ++x)
+            d[x] = s[x] > opened[x] ? uchar(s[x] - opened[x]) : 0;
+    };
+    auto emitBlack = [&](int y, int x0, int w, const uchar *closed)
+    {
+        const uchar *s = src.ptr<uchar>(y) + x0;
+        uchar *d = bh.ptr<uchar>(y) + x0;
+        for (int x = 0; x < w; ++x)
+            d[x] = closed[x] > s[x] ? uchar(closed[x] - s[x]) : 0;
+    };
+    if (tophat && blackhat)
+    {
+        vhgwHorizontal<MaxOp, MinOp>(mn, ha, kw, ax, &mx, &hb);
+        vhgwVertical<MaxOp, MinOp>(ha, &hb, kh, ay, [&](int y, int x0, int w, const uchar *opened, const uchar *closed)
+        {
+            emitTop(y, x0, w, opened);
+            emitBlack(y, x0, w, closed);
+        });
+    }
+    else if (tophat)
+    {
+        vhgwHorizontal<MaxOp>(mn, ha, kw, ax);
+        vhgwVertical<MaxOp, NoOp>(ha, nullptr, kh, ay, [&](int y, int x0, int w, const uchar *opened, const uchar *)
+        {
+            emitTop(y, x0, w, opened);
+        });
+    }
+    else if (blackhat)
+    {
+        vhgwHorizontal<MinOp>(mx, hb, kw, ax);
+        vhgwVertical<MinOp, NoOp>(hb, nullptr, kh, ay, [&](int y, int x0, int w, const uchar *closed, const uchar *)
+        {
+            emitBlack(y, x0, w, closed);
+        });
+    }
+
+    out.minimum = which & MORPH_OUT_MIN ? mn : Mat();
+    out.maximum = which & MORPH_OUT_MAX ? mx : Mat();
+    out.gradient = gradient;
+    out.tophat = th;
+    out.blackhat = bh;
+}
+
+// ---------- Arbitrary flat structuring elements (chord decomposition) ----------
+// Urbach-Wilkinson: the SE is split into horizontal chords (runs of 1s in one
+// SE row). For every input row a table holds the running extreme over 1, 2,
+// 4, ... pixels, so any chord of length l is two lookups into level
+// floor(log2 l). Each output pixel then costs about two comparisons per chord,
+// i.e. O(SE height) for disks and ellipses instead of O(SE area). Tables are
+// built once per input row and kept in a ring of SE-height rows.
+struct Chord
+{
+    int dy;     // SE row
+    int x;      // first SE column of the run
+    int len;    // run length
+    int level;  // floor(log2 len)
+};
+
+static vector<Chord> decomposeSE(const Mat &se, int &maxLevel)
+{
+    vector<Chord> chords;
+    maxLevel = 0;
+    for (int j = 0; j < se.rows; ++j)
+    {
+        const uchar *s = se.ptr<uchar>(j);
+        for (int i = 0; i < se.cols;)
+        {
+            if (!s[i])
+            {
+                ++i;
+                continue;
+            }
+            int start = i;
+            while (i < se.cols && s[i])
+                ++i;
+            Chord c = {j, start, i - start, 0};
+            while ((2 << c.level) <= c.len)
+                ++c.level;
+            maxLevel = max(maxLevel, c.level);
+            chords.push_back(c);
+        }
+    }
+    return chords;
+}
+
+template <class Op>
+static void chordMorph(const Mat &src, Mat &dst, const Mat &se, Point anchor)
+{
+    int maxLevel;
+    const vector<Chord> chords = decomposeSE(se, maxLevel);
+    const int cn = src.channels(), rows = src.rows, cols = src.cols;
+    const int width = (cols + se.cols - 1) * cn; // padded row, in bytes
+    const int levelSize = width, rowSize = (maxLevel + 1) * levelSize;
+
+    // levels of input row y: level 0 is the padded row, level i combines two
+    // halves of level i - 1
+    auto buildRow = [&](int y, uchar *t)
+    {
+        memset(t, Op::neutral, levelSize);
+        memcpy(t + anchor.x * cn, src.ptr<uchar>(y), cols * cn);
+        for (int i = 1; i <= maxLevel; ++i)
+        {
+            const uchar *a = t + (i - 1) * levelSize;
+            const int half = (1 << (i - 1)) * cn;
+            uchar *d = t + i * levelSize;
+            for (int x = 0; x + half < width; ++x)
+                d[x] = Op::apply(a[x], a[x + half]);
+        }
+    };
+
+    const int bands = max(1, min(getNumThreads(), rows));
+    parallel_for_(Range(0, bands), [&](const Range &r)
+    {
+        vector<uchar> ring(size_t(se.rows) * rowSize);
+        for (int b = r.start; b < r.end; ++b)
+        {
+            const int y0 = b * rows / bands, y1 = (b + 1) * rows / bands;
+            // input row iy lives in ring slot iy mod se.rows; fill the first window
+            int built = y0 - anchor.y;
+            for (; built < y0 - anchor.y + se.rows - 1; ++built)
+                if (built >= 0 && built < rows)
+                    buildRow(built, &ring[size_t((built % se.rows + se.rows) % se.rows) * rowSize]);
+
+            for (int y = y0; y < y1; ++y, ++built)
+            {
+                if (built >= 0 && built < rows)
+                    buildRow(built, &ring[size_t(built % se.rows) * rowSize]);
+
+                uchar *d = dst.ptr<uchar>(y);
+                memset(d, Op::neutral, cols * cn);
+                for (const Chord &c : chords)
+                {
+                    const int iy = y + c.dy - anchor.y;
+                    if (iy < 0 || iy >= rows)
+                        continue;
+                    const uchar *t = &ring[size_t(iy % se.rows) * rowSize + size_t(c.level) * levelSize];
+                    const uchar *a = t + c.x * cn;
+                    const uchar *e = a + (c.len - (1 << c.level)) * cn;
+                    for (int x = 0; x < cols * cn; ++x)
+                        d[x] = Op::apply(d[x], Op::apply(a[x], e[x]));
+                }
+            }
+        }
+    });
+}
+
+// Erode (MORPH_ERODE) or dilate (MORPH_DILATE) an 8-bit image with any flat
+// structuring element, e.g. getStructuringElement(MORPH_ELLIPSE, ...).
+// Full rectangles go to the van Herk/Gil-Werman path.
+static void flatMorph(const Mat &src, Mat &dst, int op, const Mat &se, Point anchor = Point(-1, -1))
+{
+    CV_Assert(src.depth() == CV_8U && se.type() == CV_8UC1 && !se.empty());
+    CV_Assert(op == MORPH_ERODE || op == MORPH_DILATE);
+    if (anchor.x < 0)
+        anchor = Point(se.cols / 2, se.rows / 2);
+
+    if (countNonZero(se) == se.rows * se.cols && anchor == Point(se.cols / 2, se.rows / 2) &&
+        (src.channels() == 1 || src.channels() == 3))
+    {
+        rectMorph(src, dst, op, se.size());
+        return;
+    }
+
+    // like cv::dilate, the SE is not reflected for dilation
+    Mat out(src.size(), src.type());
+    if (op == MORPH_ERODE)
+        chordMorph<MinOp>(src, out, se, anchor);
+    else
+        chordMorph<MaxOp>(src, out, se, anchor);
+    dst = out;
+}
+
+// ---------- Helper: bit counts on 64-bit words ----------
+// Set bits of a word and the index of its lowest set bit (v != 0), through
+// the GCC/Clang builtins or their MSVC counterparts
+static inline int popCount64(uint64_t v)
+{
+#ifdef _MSC_VER
+    return int(__popcnt64(v));
+#else
+    return __builtin_popcountll(v);
+#endif
+}
+
+static inline int lowestBit64(uint64_t v)
+{
+#ifdef _MSC_VER
+    unsigned long i;
+    _BitScanForward64(&i, v);
+    return int(i);
+#else
+    return __builtin_ctzll(v);
+#endif
+}
+
+// ---------- Bit-packed binary images ----------
+// 64 pixels per uint64_t, pixel x of a row is bit x % 64 of word x / 64.
+// Bits past the last column are kept 0. Morphology works on whole words:
+// a window of k pixels is the AND/OR of log2(k) shifted copies, so one
+// operation handles 64 pixels and the image takes 1/8 of the memory.
+// Outside the image erosion sees 1s and dilation 0s, as erode/dilate do.
+class BitImage
+{
+public:
+    int rows = 0, cols = 0, words = 0; // words per row
+
+    BitImage() {}
+    BitImage(int rows, int cols)
+        : rows(rows), cols(cols), words((cols + 63) / 64), bits(size_t(rows) * ((cols + 63) / 64), 0)
+    {
+    }
+
+    // nonzero pixels of a CV_8UC1 image are set
+    explicit BitImage(const Mat &m) : BitImage(m.rows, m.cols)
+    {
+        CV_Assert(m.type() == CV_8UC1);
+        parallel_for_(Range(0, rows), [&](const Range &r)
+        {
+            for (int y = r.start; y < r.end; ++y)
+            {
+                const uchar *p = m.ptr<uchar>(y);
+                uint64_t *w = row(y);
+                for (int i = 0; i < words; ++i)
+                {
+                    uint64_t v = 0;
+                    const int n = min(64, cols - i * 64);
+                    for (int b = 0; b < n; ++b)
+                        v |= uint64_t(p[i * 64 + b] != 0) << b;
+                    w[i] = v;
+                }
+            }
+        });
+    }
+
+    // 0/255 CV_8UC1
+    Mat toMat() const
+    {
+        Mat m(rows, cols, CV_8UC1);
+        parallel_for_(Range(0, rows), [&](const Range &r)
+        {
+            for (int y = r.start; y < r.end; ++y)
+            {
+                uchar *p = m.ptr<uchar>(y);
+                const uint64_t *w = row(y);
+                for (int x = 0; x < cols; ++x)
+                    p[x] = uchar(0 - ((w[x >> 6] >> (x & 63)) & 1));
+            }
+        });
+        return m;
+    }
+
+    uint64_t *row(int y) { return &bits[size_t(y) * words]; }
+    const uint64_t *row(int y) const { return &bits[size_t(y) * words]; }
+    bool get(int x, int y) const { return (row(y)[x >> 6] >> (x & 63)) & 1; }
+    void set(int x, int y, bool v)
+    {
+        uint64_t m = uint64_t(1) << (x & 63);
+        row(y)[x >> 6] = v ? row(y)[x >> 6] | m : row(y)[x >> 6] & ~m;
+    }
+
+    // number of set pixels
+    int64_t area() const
+    {
+        int64_t n = 0;
+        for (uint64_t w : bits)
+            n += popCount64(w);
+        return n;
+    }
+
+    BitImage operator&(const BitImage &o) const { return combine(o, [](uint64_t a, uint64_t b) { return a & b; }); }
+    BitImage operator|(const BitImage &o) const { return combine(o, [](uint64_t a, uint64_t b) { return a | b; }); }
+    BitImage operator^(const BitImage &o) const { return combine(o, [](uint64_t a, uint64_t b) { return a ^ b; }); }
+    BitImage operator~() const
+    {
+        BitImage r = *this;
+        for (uint64_t &w : r.bits)
+            w = ~w;
+        r.clearTail();
+        return r;
+    }
+
+    // ksize rectangle anchored at its centre; `iterations` folds a chain of
+    // identical ops into one larger rectangle like rectMorph
+    BitImage eroded(Size ksize, int iterations = 1) const { return rectOp(ksize, iterations, true); }
+    BitImage dilated(Size ksize, int iterations = 1) const { return rectOp(ksize, iterations, false); }
+    BitImage opened(Size ksize, int iterations = 1) const { return eroded(ksize, iterations).dilated(ksize, iterations); }
+    BitImage closed(Size ksize, int iterations = 1) const { return dilated(ksize, iterations).eroded(ksize, iterations); }
+
+    // MORPH_HITMISS: kernel entries 1 must be set, -1 must be clear, 0 are
+    // ignored (CV_8S or CV_32S kernel, anchored at its centre)
+    BitImage hitOrMiss(const Mat &kernel) const
+    {
+        CV_Assert(kernel.depth() == CV_8S || kernel.depth() == CV_32S);
+        BitImage inv = ~*this;
+        BitImage out(rows, cols);
+        for (uint64_t &w : out.bits)
+            w = ~uint64_t(0);
+        vector<uint64_t> tmp(words);
+        for (int j = 0; j < kernel.rows; ++j)
+            for (int i = 0; i < kernel.cols; ++i)
+            {
+                int k = kernel.depth() == CV_8S ? kernel.at<schar>(j, i) : kernel.at<int>(j, i);
+                if (k == 0)
+                    continue;
+                const BitImage &src = k > 0 ? *this : inv;
+                const int dx = i - kernel.cols / 2, dy = j - kernel.rows / 2;
+                for (int y = 0; y < rows; ++y)
+                {
+                    uint64_t *o = out.row(y);
+                    const int sy = y + dy;
+                    if (sy < 0 || sy >= rows)
+                        continue; // outside counts as a match, like erode's border
+                    shiftBits(src.row(sy), cols, dx, ~uint64_t(0), &tmp[0], words);
+                    for (int w = 0; w < words; ++w)
+                        o[w] &= tmp[w];
+                }
+            }
+        out.clearTail();
+        return out;
+    }
+
+    // One seed point per 8-connected component (its first pixel in raster
+    // order), from a run-length union-find pass over the packed rows
+    vector<Point> componentSeeds() const
+    {
+        struct Run
+        {
+            int y, x0, x1;
+        };
+        vector<Run> runs;
+        vector<int> parent;
+        auto find = [&](int a)
+        {
+            while (parent[a] != a)
+                a = parent[a] = parent[parent[a]];
+            return a;
+        };
+
+        size_t prevBegin = 0, prevEnd = 0;
+        for (int y = 0; y < rows; ++y)
+        {
+            const size_t begin = runs.size();
+            const uint64_t *w = row(y);
+            for (int x = 0; x < cols;)
+            {
+                // skip clear bits, then set bits, a word at a time
+                uint64_t v = w[x >> 6] >> (x & 63);
+                if (!v)
+                {
+                    x = (x | 63) + 1;
+                    continue;
+                }
+                x += lowestBit64(v);
+                if (x >= cols)
+                    break;
+                int start = x;
+                while (x < cols)
+                {
+                    uint64_t inv = ~w[x >> 6] >> (x & 63);
+                    int n = inv ? lowestBit64(inv) : 64 - (x & 63);
+                    x += n;
+                    if (inv)
+                        break;
+                }
+                x = min(x, cols);
+                runs.push_back({y, start, x});
+                parent.push_back(int(parent.size()));
+            }
+            const size_t end = runs.size();
+            // runs of the previous row touching (8-connectivity) join this one
+            size_t p = prevBegin;
+            for (size_t c = begin; c < end; ++c)
+            {
+                while (p < prevEnd && runs[p].x1 < runs[c].x0)
+                    ++p;
+                for (size_t q = p; q < prevEnd && runs[q].x0 <= runs[c].x1; ++q)
+                {
+                    int a = find(int(q)), b = find(int(c));
+                    if (a != b)
+                        parent[max(a, b)] = min(a, b);
+                }
+            }
+            prevBegin = begin;
+            prevEnd = end;
+        }
+
+        vector<Point> seeds;
+        for (size_t i = 0; i < runs.size(); ++i)
+            if (find(int(i)) == int(i))
+                seeds.push_back(Point(runs[i].x0, runs[i].y));
+        return seeds;
+    }
+
+private:
+    vector<uint64_t> bits;
+
+    void clearTail()
+    {
+        if (cols % 64 == 0)
+            return;
+        const uint64_t mask = (uint64_t(1) << (cols % 64)) - 1;
+        for (int y = 0; y < rows; ++y)
+            row(y)[words - 1] &= mask;
+    }
+
+    template <class F>
+    BitImage combine(const BitImage &o, F f) const
+    {
+        CV_Assert(rows == o.rows && cols == o.cols);
+        BitImage r(rows, cols);
+        for (size_t i = 0; i < bits.size(); ++i)
+            r.bits[i] = f(bits[i], o.bits[i]);
+        return r;
+    }
+
+    // out bit x (x < outWords * 64) = bit x + d of a row of srcCols pixels;
+    // pixels outside that row read as `fill`
+    static void shiftBits(const uint64_t *src, int srcCols, int d, uint64_t fill, uint64_t *out, int outWords)
+    {
+        const int srcWords = (srcCols + 63) / 64, tail = srcCols % 64;
+        const uint64_t keep = tail ? (uint64_t(1) << tail) - 1 : ~uint64_t(0);
+        auto word = [&](int j)
+        {
+            if (j < 0 || j >= srcWords)
+                return fill;
+            return j == srcWords - 1 ? (src[j] & keep) | (fill & ~keep) : src[j];
+        };
+        const int q = d >= 0 ? d / 64 : -((-d + 63) / 64);
+        const int r = d - q * 64;
+        for (int i = 0; i < outWords; ++i)
+        {
+            uint64_t lo = word(i + q);
+            out[i] = r ? (lo >> r) | (word(i + q + 1) << (64 - r)) : lo;
+        }
+    }
+
+    // AND (erode) or OR (dilate) over a kw x kh window. The source is first
+    // laid out on an extended line (and row range) starting at the window
+    // origin; runs of 1, 2, 4, ... pixels are built by doubling and any
+    // window is two overlapping power-of-two runs.
+    BitImage rectOp(Size ksize, int iterations, bool erode) const
+    {
+        const int kw = iterations * (ksize.width - 1) + 1, kh = iterations * (ksize.height - 1) + 1;
+        const int ax = iterations * (ksize.width / 2), ay = iterations * (ksize.height / 2);
+        const uint64_t fill = erode ? ~uint64_t(0) : 0;
+        auto op = [erode](uint64_t a, uint64_t b) { return erode ? a & b : a | b; };
+
+        // horizontal: ext[x] = src[x - ax] over cols + kw - 1 pixels
+        const int extCols = cols + kw - 1, extWords = (extCols + 63) / 64;
+        BitImage h(rows, cols);
+        parallel_for_(Range(0, rows), [&](const Range &r)
+        {
+            vector<uint64_t> a(extWords), b(extWords), c(extWords);
+            for (int y = r.start; y < r.end; ++y)
+            {
+                shiftBits(row(y), cols, -ax, fill, &a[0], extWords);
+                int p = 1;
+                for (; p * 2 <= kw; p *= 2)
+                {
+                    shiftBits(&a[0], extCols, p, fill, &b[0], extWords);
+                    for (int i = 0; i < extWords; ++i)
+                        a[i] = op(a[i], b[i]);
+                }
+                shiftBits(&a[0], extCols, kw - p, fill, &b[0], words);
+                uint64_t *o = h.row(y);
+                for (int i = 0; i < words; ++i)
+                    o[i] = op(a[i], b[i]);
+            }
+        });
+        h.clearTail();
+
+        // vertical: the same doubling on whole rows of an extended row range,
+        // ext[y] = h[y - ay]; pure word-wise ops
+        const int extRows = rows + kh - 1;
+        vector<uint64_t> ext(size_t(extRows) * words, fill);
+        for (int y = 0; y < rows; ++y)
+            memcpy(&ext[size_t(y + ay) * words], h.row(y), words * sizeof(uint64_t));
+        int p = 1;
+        for (; p * 2 <= kh; p *= 2)
+            for (int y = 0; y < extRows; ++y)
+            {
+                uint64_t *a = &ext[size_t(y) * words];
+                if (y + p < extRows)
+                {
+                    const uint64_t *b = a + size_t(p) * words;
+                    for (int i = 0; i < words; ++i)
+                        a[i] = op(a[i], b[i]);
+                }
+            }
+        BitImage out(rows, cols);
+        for (int y = 0; y < rows; ++y)
+        {
+            const uint64_t *a = &ext[size_t(y) * words], *b = &ext[size_t(y + kh - p) * words];
+            uint64_t *o = out.row(y);
+            for (int i = 0; i < words; ++i)
+                o[i] = op(a[i], b[i]);
+        }
+        out.clearTail();
+        return out;
+    }
+};
+
+// ---------- Granulometry: morphology over a growing SE sequence ----------
+// If B[i] = B[i-1] (+) D (Minkowski sum, offsets relative to the SE centres),
+// eroding/dilating the previous result by the small D gives the result for
+// B[i]. seIncrement finds the largest such D (B[i] minus B[i-1]) and checks
+// that it rebuilds B[i] exactly; for rectangles and most discrete disks it does.
+static bool seIncrement(const Mat &from, const Mat &to, Mat &step, Point &anchor)
+{
+    const Point fa(from.cols / 2, from.rows / 2), ta(to.cols / 2, to.rows / 2);
+    int minI = from.cols, maxI = -1, minJ = from.rows, maxJ = -1;
+    for (int j = 0; j < from.rows; ++j)
+        for (int i = 0; i < from.cols; ++i)
+            if (from.at<uchar>(j, i))
+            {
+                minI = min(minI, i), maxI = max(maxI, i);
+                minJ = min(minJ, j), maxJ = max(maxJ, j);
+            }
+    if (maxI < 0)
+        return false;
+
+    // shifts that keep the bounding box of `from` inside `to`; the range is
+    // widened to contain 0 so that offset 0 can be the anchor of `step`
+    const int x0 = min(0, fa.x - ta.x - minI), x1 = max(0, to.cols - 1 - ta.x + fa.x - maxI);
+    const int y0 = min(0, fa.y - ta.y - minJ), y1 = max(0, to.rows - 1 - ta.y + fa.y - maxJ);
+    step = Mat::zeros(y1 - y0 + 1, x1 - x0 + 1, CV_8UC1);
+    anchor = Point(-x0, -y0);
+
+    // from shifted by (dx, dy), in the pixel grid of `to`
+    auto place = [&](int i, int j, int dx, int dy)
+    {
+        return Point(i - fa.x + dx + ta.x, j - fa.y + dy + ta.y);
+    };
+
+    Mat covered = Mat::zeros(to.size(), CV_8UC1);
+    for (int dy = y0; dy <= y1; ++dy)
+        for (int dx = x0; dx <= x1; ++dx)
+        {
+            bool fits = true;
+            for (int j = minJ; j <= maxJ && fits; ++j)
+                for (int i = minI; i <= maxI && fits; ++i)
+                {
+                    if (!from.at<uchar>(j, i))
+                        continue;
+                    Point p = place(i, j, dx, dy);
+                    fits = p.x >= 0 && p.y >= 0 && p.x < to.cols && p.y < to.rows && to.at<uchar>(p.y, p.x);
+                }
+            if (!fits)
+                continue;
+            step.at<uchar>(dy - y0, dx - x0) = 1;
+            for (int j = minJ; j <= maxJ; ++j)
+                for (int i = minI; i <= maxI; ++i)
+                    if (from.at<uchar>(j, i))
+                    {
+                        Point p = place(i, j, dx, dy);
+                        covered.at<uchar>(p.y, p.x) = 1;
+                    }
+        }
+
+    // from (+) step must rebuild `to` exactly
+    for (int y = 0; y < to.rows; ++y)
+        for (int x = 0; x < to.cols; ++x)
+            if ((to.at<uchar>(y, x) != 0) != (covered.at<uchar>(y, x) != 0))
+                return false;
+    return countNonZero(step) > 0;
+}
+
+// Erode or dilate `src` by each SE of `ses` (centred anchors) in turn and hand
+// every result to `visit`. Where seIncrement succeeds the result is built from
+// the previous one; otherwise it is computed from the source. The sweep runs
+// on a copy padded with the neutral value by the largest SE extent, so the
+// chained results match eroding/dilating the original directly.
+static void morphSweep(const Mat &src, const vector<Mat> &ses, int op,
+                       const function<void(int, const Mat &)> &visit)
+{
+    CV_Assert(op == MORPH_ERODE || op == MORPH_DILATE);
+    int px = 0, py = 0;
+    for (const Mat &se : ses)
+    {
+        px = max(px, se.cols);
+        py = max(py, se.rows);
+    }
+    Mat padded;
+    copyMakeBorder(src, padded, py, py, px, px, BORDER_CONSTANT, Scalar::all(op == MORPH_ERODE ? 255 : 0));
+    const Rect inner(px, py, src.cols, src.rows);
+
+    Mat cur;
+    for (size_t i = 0; i < ses.size(); ++i)
+    {
+        Mat step;
+        Point anchor;
+        if (i > 0 && seIncrement(ses[i - 1], ses[i], step, anchor))
+            flatMorph(cur, cur, op, step, anchor);
+        else
+            flatMorph(padded, cur, op, ses[i]);
+        visit(int(i), cur(inner));
+    }
+}
+
+// Pattern spectrum: amount removed by opening with ses[i] that was still
+// present after opening with ses[i - 1] (before ses[0]: the image itself).
+// Measured as sum / 255, so for a 0/255 mask it is the area of the particles
+// in each size class and for grayscale images the volume. No images are kept.
+static vector<double> patternSpectrum(const Mat &src, const vector<Mat> &ses)
+{
+    CV_Assert(src.type() == CV_8UC1);
+    vector<double> spectrum(ses.size());
+    double prev = sum(src)[0] / 255.0;
+    morphSweep(src, ses, MORPH_ERODE, [&](int i, const Mat &eroded)
+    {
+        Mat opened;
+        flatMorph(eroded, opened, MORPH_DILATE, ses[i]);
+        double s = sum(opened)[0] / 255.0;
+        spectrum[i] = prev - s;
+        prev = s;
+    });
+    return spectrum;
+}
+
 int main()
 {
     // --- A. Feladat ---
@@ -29,38 +994,39 @@ int main()
     }
     threshold(bin, bin, 128, 255, THRESH_BINARY);
 
-    Mat eroded, dilated, open, close;
-    Mat element = getStructuringElement(MORPH_RECT, Size(3, 3));
-
-    // 10x erode, then 10x dilate (opening)
-    eroded = bin.clone();
-    for (int i = 0; i < 10; ++i)
-        erode(eroded, eroded, element);
-    dilated = eroded.clone();
-    for (int i = 0; i < 10; ++i)
-        dilate(dilated, dilated, element);
-    Mat openResult = dilated;
+    // binary mask, 64 pixels per word
+    BitImage bits(bin);
+    cout << "A: " << bits.area() << " foreground pixels, "
+         << bits.componentSeeds().size() << " components" << endl;
+
+    // 10x erode, then 10x dilate (opening); each chain is one 21x21 pass
+    Mat openResult = bits.opened(Size(3, 3), 10).toMat();
     if (!showAndWait("A: 10x erode, 10x dilate (Opening)", openResult))
         return 0;
 
     // 10x dilate, then 10x erode (closing)
-    dilated = bin.clone();
-    for (int i = 0; i < 10; ++i)
-        dilate(dilated, dilated, element);
-    eroded = dilated.clone();
-    for (int i = 0; i < 10; ++i)
-        erode(eroded, eroded, element);
-    Mat closeResult = eroded;
+    Mat closeResult = bits.closed(Size(3, 3), 10).toMat();
     if (!showAndWait("A: 10x dilate, 10x erode (Closing)", closeResult))
         return 0;
 
     // --- B. Feladat ---
+    // each ellipse is grown from the previous result where the SEs decompose
+    vector<Mat> ellipses;
     for (int r = 1; r <= 11; r += 2)
+        ellipses.push_back(getStructuringElement(MORPH_ELLIPSE, Size(r, r)));
+    vector<Mat> erodedB(ellipses.size()), dilatedB(ellipses.size());
+    morphSweep(bin, ellipses, MORPH_ERODE, [&](int i, const Mat &m) { m.copyTo(erodedB[i]); });
+    morphSweep(bin, ellipses, MORPH_DILATE, [&](int i, const Mat &m) { m.copyTo(dilatedB[i]); });
+
+    vector<double> spectrum = patternSpectrum(bin, ellipses);
+    cout << "B: pattern spectrum (area removed per ellipse size)" << endl;
+    for (size_t i = 0; i < spectrum.size(); ++i)
+        cout << "  r=" << 2 * i + 1 << ": " << spectrum[i] << endl;
+
+    for (size_t i = 0; i < ellipses.size(); ++i)
     {
-        Mat ell = getStructuringElement(MORPH_ELLIPSE, Size(r, r));
-        Mat er, di;
-        erode(bin, er, ell);
-        dilate(bin, di, ell);
+        int r = int(2 * i + 1);
+        Mat &er = erodedB[i], &di = dilatedB[i];
         Mat grid(bin.rows, bin.cols * 2, bin.type());
         er.copyTo(grid(Rect(0, 0, bin.cols, bin.rows)));
         di.copyTo(grid(Rect(bin.cols, 0, bin.cols, bin.rows)));
@@ -82,11 +1048,16 @@ int main()
     line(scribble_black, Point(100, 50), Point(300, 250), Scalar(0, 0, 0), 8);
     line(scribble_black, Point(50, 250), Point(250, 50), Scalar(0, 0, 0), 6);
 
+    // rectangles 3, 9, 15, 21: each result grows the previous one by a 7x7 step
+    vector<Mat> rects;
+    for (int r = 3; r <= 21; r += 6)
+        rects.push_back(getStructuringElement(MORPH_RECT, Size(r, r)));
+    vector<Mat> sweepC(rects.size());
+    morphSweep(scribble_black, rects, MORPH_DILATE, [&](int i, const Mat &m) { m.copyTo(sweepC[i]); });
+
     for (int r = 3; r <= 21; r += 6)
     {
-        Mat elem = getStructuringElement(MORPH_RECT, Size(r, r));
-        Mat dil;
-        dilate(scribble_black, dil, elem);
+        Mat &dil = sweepC[(r - 3) / 6];
         Mat grid(color.rows, color.cols * 2, color.type());
         scribble_black.copyTo(grid(Rect(0, 0, color.cols, color.rows)));
         dil.copyTo(grid(Rect(color.cols, 0, color.cols, color.rows)));
@@ -101,11 +1072,11 @@ int main()
     line(scribble_white, Point(100, 50), Point(300, 250), Scalar(255, 255, 255), 8);
     line(scribble_white, Point(50, 250), Point(250, 50), Scalar(255, 255, 255), 6);
 
+    morphSweep(scribble_white, rects, MORPH_ERODE, [&](int i, const Mat &m) { m.copyTo(sweepC[i]); });
+
     for (int r = 3; r <= 21; r += 6)
     {
-        Mat elem = getStructuringElement(MORPH_RECT, Size(r, r));
-        Mat ero;
-        erode(scribble_white, ero, elem);
+        Mat &ero = sweepC[(r - 3) / 6];
         Mat grid(color.rows, color.cols * 2, color.type());
         scribble_white.copyTo(grid(Rect(0, 0, color.cols, color.rows)));
         ero.copyTo(grid(Rect(color.cols, 0, color.cols, color.rows)));
@@ -118,9 +1089,9 @@ int main()
     // --- D. Feladat ---
     for (int r = 3; r <= 21; r += 6)
     {
-        Mat elem = getStructuringElement(MORPH_RECT, Size(r, r));
-        Mat grad;
-        morphologyEx(color, grad, MORPH_GRADIENT, elem);
+        MorphOutputs mo;
+        rectMorphFused(color, Size(r, r), MORPH_OUT_GRADIENT, mo);
+        Mat &grad = mo.gradient;
         Mat grid(color.rows, color.cols * 2, color.type());
         color.copyTo(grid(Rect(0, 0, color.cols, color.rows)));
         grad.copyTo(grid(Rect(color.cols, 0, color.cols, color.rows)));
@@ -137,9 +1108,7 @@ int main()
         cerr << "Nem találom a kukac.png képet!" << endl;
         return 1;
     }
-    Mat imH(kukac.size(), CV_8UC1);
-    for (int x = 0; x < imH.cols; ++x)
-        imH(Rect(x, 0, 1, imH.rows)).setTo(Scalar(x * 256 / imH.cols));
+    Mat imH = synth::render(synth::gradient(kukac.rows, kukac.cols, synth::GRADIENT_HORIZONTAL));
 
     // TopHat: kukacok világosabbak a háttérnél
     Mat inputTopHat;
@@ -147,9 +1116,9 @@ int main()
 
     for (int r = 3; r <= 21; r += 6)
     {
-        Mat elem = getStructuringElement(MORPH_RECT, Size(r, r));
-        Mat tophat;
-        morphologyEx(inputTopHat, tophat, MORPH_TOPHAT, elem);
+        MorphOutputs mo;
+        rectMorphFused(inputTopHat, Size(r, r), MORPH_OUT_TOPHAT, mo);
+        Mat &tophat = mo.tophat;
         Mat grid(kukac.rows, kukac.cols * 2, kukac.type());
         inputTopHat.copyTo(grid(Rect(0, 0, kukac.cols, kukac.rows)));
         tophat.copyTo(grid(Rect(kukac.cols, 0, kukac.cols, kukac.rows)));
@@ -165,9 +1134,9 @@ int main()
 
     for (int r = 3; r <= 21; r += 6)
     {
-        Mat elem = getStructuringElement(MORPH_RECT, Size(r, r));
-        Mat blackhat;
-        morphologyEx(inputBlackHat, blackhat, MORPH_BLACKHAT, elem);
+        MorphOutputs mo;
+        rectMorphFused(inputBlackHat, Size(r, r), MORPH_OUT_BLACKHAT, mo);
+        Mat &blackhat = mo.blackhat;
         Mat grid(kukac.rows, kukac.cols * 2, kukac.type());
         inputBlackHat.copyTo(grid(Rect(0, 0, kukac.cols, kukac.rows)));
         blackhat.copyTo(grid(Rect(kukac.cols, 0, kukac.cols, kukac.rows)));
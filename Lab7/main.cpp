@@ -1,4 +1,14 @@
 #include <opencv2/opencv.hpp>
+#include <opencv2/core/hal/intrin.hpp>
+#include "../Synth/synth.hpp"
+#include <bitset>
+#include <cfloat>
+#include <chrono>
+#include <climits>
+#include <cstdint>
+#include <functional>
+#include <queue>
+#include <set>
 using namespace cv;
 using namespace std;
 
@@ -19,14 +29,1132 @@ static Mat loadImage(const string &filename, int flags = IMREAD_GRAYSCALE)
     return Mat();
 }
 
-// ---------- Helper: get and set gray pixel ----------
-static inline uchar getGray(const Mat &im, int x, int y)
+// ---------- 3x3 hit-or-miss through lookup tables ----------
+// Masks are 9 entries in raster order: 1 = foreground, 0 = background,
+// -1 = don't care (the Golay table convention). The 8 neighbours of a pixel
+// form one byte, bits 0-2 the row above (left to right), 3 left, 4 right,
+// 5-7 the row below. A set of up to 32 masks compiles into 2 x 256 words
+// (centre clear / set); bit l of table[centre][code] says whether mask l
+// matches, so testing a mask, or every mask at once, is a single lookup.
+class HitMiss3x3
 {
-    return im.at<uchar>(y, x);
+public:
+    // a single "mask" given as a rule on (centre, code) instead
+    explicit HitMiss3x3(const function<bool(bool, uchar)> &rule) : count(1)
+    {
+        for (int centre = 0; centre < 2; ++centre)
+            for (int code = 0; code < 256; ++code)
+                table[centre][code] = rule(centre != 0, uchar(code));
+    }
+
+    HitMiss3x3(const int *masks, int count) : count(count)
+    {
+        CV_Assert(count > 0 && count <= 32);
+        for (int centre = 0; centre < 2; ++centre)
+            for (int code = 0; code < 256; ++code)
+            {
+                uint32_t m = 0;
+                for (int l = 0; l < count; ++l)
+                {
+                    bool match = true;
+                    for (int i = 0; i < 9 && match; ++i)
+                    {
+                        const int want = masks[9 * l + i];
+                        const int bit = i == 4 ? centre : (code >> (i < 4 ? i : i - 1)) & 1;
+                        match = want < 0 || want == bit;
+                    }
+                    m |= uint32_t(match) << l;
+                }
+                table[centre][code] = m;
+            }
+    }
+
+    int size() const { return count; }
+    uint32_t matches(bool centre, uchar code) const { return table[centre][code]; }
+    bool matches(int mask, bool centre, uchar code) const { return (table[centre][code] >> mask) & 1; }
+
+    // dst = 255 where any mask of maskSet matches bin (outside the image is background)
+    void apply(const Mat &bin, Mat &dst, uint32_t maskSet = ~0u) const;
+
+private:
+    int count;
+    uint32_t table[2][256];
+};
+
+// 8-neighbour code of every pixel of a binary (0 / nonzero) CV_8UC1 image,
+// outside the image is background. Rows are widened to 0/255 with a zero
+// column on each side, then each neighbour contributes (row & bit), so a
+// code costs 8 loads, ANDs and ORs per CV_SIMD_WIDTH pixels.
+static void neighbourCodes(const Mat &bin, Mat &codes)
+{
+    CV_Assert(bin.type() == CV_8UC1);
+    codes.create(bin.size(), CV_8UC1);
+    const int rows = bin.rows, cols = bin.cols, w = cols + 2;
+    parallel_for_(Range(0, rows), [&](const Range &r)
+    {
+        vector<uchar> buf(3 * w, 0);
+        auto widen = [&](int y, uchar *q)
+        {
+            if (y < 0 || y >= rows)
+            {
+                memset(q, 0, w);
+                return;
+            }
+            const uchar *p = bin.ptr<uchar>(y);
+            for (int x = 0; x < cols; ++x)
+                q[x + 1] = p[x] ? 255 : 0;
+        };
+        uchar *up = &buf[0], *mid = &buf[w], *dn = &buf[2 * w];
+        widen(r.start - 1, up);
+        widen(r.start, mid);
+        for (int y = r.start; y < r.end; ++y)
+        {
+            widen(y + 1, dn);
+            uchar *c = codes.ptr<uchar>(y);
+            int x = 0;
+#if CV_SIMD
+            const v_uint8 b0 = vx_setall_u8(1), b1 = vx_setall_u8(2), b2 = vx_setall_u8(4), b3 = vx_setall_u8(8);
+            const v_uint8 b4 = vx_setall_u8(16), b5 = vx_setall_u8(32), b6 = vx_setall_u8(64), b7 = vx_setall_u8(128);
+            for (; x <= cols - CV_SIMD_WIDTH; x += CV_SIMD_WIDTH)
+            {
+                v_uint8 v = (vx_load(up + x) & b0) | (vx_load(up + x + 1) & b1) | (vx_load(up + x + 2) & b2) |
+                            (vx_load(mid + x) & b3) | (vx_load(mid + x + 2) & b4) |
+                            (vx_load(dn + x) & b5) | (vx_load(dn + x + 1) & b6) | (vx_load(dn + x + 2) & b7);
+                v_store(c + x, v);
+            }
+#endif
+            for (; x < cols; ++x)
+                c[x] = uchar((up[x] & 1) | (up[x + 1] & 2) | (up[x + 2] & 4) | (mid[x] & 8) | (mid[x + 2] & 16) |
+                             (dn[x] & 32) | (dn[x + 1] & 64) | (dn[x + 2] & 128));
+            uchar *t = up;
+            up = mid;
+            mid = dn;
+            dn = t;
+        }
+    });
+}
+
+void HitMiss3x3::apply(const Mat &bin, Mat &dst, uint32_t maskSet) const
+{
+    Mat codes;
+    neighbourCodes(bin, codes);
+    dst.create(bin.size(), CV_8UC1);
+    parallel_for_(Range(0, bin.rows), [&](const Range &r)
+    {
+        for (int y = r.start; y < r.end; ++y)
+        {
+            const uchar *p = bin.ptr<uchar>(y), *c = codes.ptr<uchar>(y);
+            uchar *d = dst.ptr<uchar>(y);
+            for (int x = 0; x < bin.cols; ++x)
+                d[x] = (table[p[x] != 0][c[x]] & maskSet) ? 255 : 0;
+        }
+    });
+}
+
+// Golay L masks: one thinning sub-iteration each
+static const int Golay[72] = {
+    0, 0, 0, -1, 1, -1, 1, 1, 1,
+    -1, 0, 0, 1, 1, 0, -1, 1, -1,
+    1, -1, 0, 1, 1, 0, 1, -1, 0,
+    -1, 1, -1, 1, 1, 0, -1, 0, 0,
+    1, 1, 1, -1, 1, -1, 0, 0, 0,
+    -1, 1, -1, 0, 1, 1, 0, 0, -1,
+    0, -1, 1, 0, 1, 1, 0, -1, 1,
+    0, 0, -1, 0, 1, 1, -1, 1, -1};
+
+// end points: a foreground pixel with exactly one foreground neighbour
+static const int Endpoint[72] = {
+    1, 0, 0, 0, 1, 0, 0, 0, 0,
+    0, 1, 0, 0, 1, 0, 0, 0, 0,
+    0, 0, 1, 0, 1, 0, 0, 0, 0,
+    0, 0, 0, 1, 1, 0, 0, 0, 0,
+    0, 0, 0, 0, 1, 1, 0, 0, 0,
+    0, 0, 0, 0, 1, 0, 1, 0, 0,
+    0, 0, 0, 0, 1, 0, 0, 1, 0,
+    0, 0, 0, 0, 1, 0, 0, 0, 1};
+
+// ---------- Thinning driven by the border pixels ----------
+// 8-neighbour code of an interior pixel, same bit order as neighbourCodes
+static inline uchar neighbourCode(const uchar *p, size_t step)
+{
+    const uchar *u = p - step, *d = p + step;
+    return uchar((u[-1] != 0) | (u[0] != 0) << 1 | (u[1] != 0) << 2 | (p[-1] != 0) << 3 | (p[1] != 0) << 4 |
+                 (d[-1] != 0) << 5 | (d[0] != 0) << 6 | (d[1] != 0) << 7);
+}
+
+// Sequential thinning with the masks of `masks` taken in turn, one
+// sub-iteration each, on the interior of `im` (the border rows and columns
+// are left alone), until a round of all masks deletes nothing.
+// Within a sub-iteration every decision reads the image as it was before
+// it, like the clone-per-mask loop, but the image is only written once the
+// decisions are in. Only border pixels (foreground with a background
+// neighbour) can match, so only those are queued; a deleted pixel queues its
+// foreground neighbours, and a pixel that failed every mask with an
+// unchanged neighbourhood leaves the queue. The work per round follows the
+// contour length, not the image area.
+// onRound(round, deleted) runs after every round; returning false stops.
+// Returns the number of rounds.
+static int thinBorderQueue(Mat &im, const HitMiss3x3 &masks,
+                           const function<bool(int, int)> &onRound = nullptr)
+{
+    CV_Assert(im.type() == CV_8UC1 && im.isContinuous());
+    const int rows = im.rows, cols = im.cols, n = masks.size();
+    const size_t step = im.step;
+    uchar *data = im.data;
+    if (rows < 3 || cols < 3)
+        return 0;
+
+    // misses[i]: masks failed since the neighbourhood last changed, or
+    // NOT_QUEUED; queued pixels are also listed in `queue`
+    const uchar NOT_QUEUED = 255;
+    vector<uchar> misses(size_t(rows) * cols, NOT_QUEUED);
+    vector<int> queue, next, deleted;
+    Mat codes;
+    neighbourCodes(im, codes);
+    for (int y = 1; y < rows - 1; ++y)
+        for (int x = 1; x < cols - 1; ++x)
+        {
+            const int i = y * cols + x;
+            if (data[i] && codes.at<uchar>(y, x) != 0xFF)
+            {
+                misses[i] = 0;
+                queue.push_back(i);
+            }
+        }
+
+    int rounds = 0, total;
+    do
+    {
+        total = 0;
+        for (int l = 0; l < n; ++l)
+        {
+            // decide on the unchanged image
+            deleted.clear();
+            next.clear();
+            for (int i : queue)
+            {
+                if (masks.matches(l, true, neighbourCode(data + i, step)))
+                    deleted.push_back(i);
+                else if (++misses[i] < n)
+                    next.push_back(i);
+                else
+                    misses[i] = NOT_QUEUED;
+            }
+            // then write, and requeue the neighbours of deleted pixels
+            for (int i : deleted)
+            {
+                data[i] = 0;
+                misses[i] = NOT_QUEUED;
+            }
+            for (int i : deleted)
+            {
+                const int y = i / cols, x = i % cols;
+                for (int dy = -1; dy <= 1; ++dy)
+                    for (int dx = -1; dx <= 1; ++dx)
+                    {
+                        const int yy = y + dy, xx = x + dx, j = yy * cols + xx;
+                        if (yy < 1 || yy >= rows - 1 || xx < 1 || xx >= cols - 1 || !data[j])
+                            continue;
+                        if (misses[j] == NOT_QUEUED)
+                            next.push_back(j);
+                        misses[j] = 0;
+                    }
+            }
+            swap(queue, next);
+            total += int(deleted.size());
+        }
+        ++rounds;
+        if (onRound && !onRound(rounds, total))
+            break;
+    } while (total > 0);
+    return rounds;
+}
+
+// ---------- Parallel thinning over subfields ----------
+// The interior is split into 4 subfields by the parity of x and y. No two
+// pixels of a subfield are 8-neighbours, so a pass over one subfield can
+// delete in place: its decisions only read pixels of the other three, which
+// the pass does not touch. The rows of a pass therefore run in parallel and
+// the result does not depend on the thread count or the scheduling.
+// The Golay masks are meant for all-at-once application and leave 2-pixel
+// thick lines when applied per subfield, so a pass deletes by the usual
+// sequential rule instead: a simple point (Yokoi 8-connectivity number 1,
+// which keeps the topology) that is not an end point.
+static bool deletableSimplePoint(bool centre, uchar code)
+{
+    if (!centre || bitset<8>(code).count() < 2)
+        return false;
+    // neighbours counter-clockwise from east, as bits of the code
+    static const int ring[8] = {4, 2, 1, 0, 3, 5, 6, 7};
+    int bg[9];
+    for (int k = 0; k < 9; ++k)
+        bg[k] = !((code >> ring[k % 8]) & 1);
+    int nc = 0;
+    for (int k = 0; k < 8; k += 2)
+        nc += bg[k] - bg[k] * bg[k + 1] * bg[k + 2];
+    return nc == 1;
+}
+
+static int thinSubfields(Mat &im, const function<bool(int, int)> &onRound = nullptr)
+{
+    static const HitMiss3x3 rule(deletableSimplePoint);
+    CV_Assert(im.type() == CV_8UC1);
+    const int rows = im.rows, cols = im.cols;
+    if (rows < 3 || cols < 3)
+        return 0;
+
+    // a row whose 3-row neighbourhood saw no deletion during the last 4
+    // passes (one per subfield) has been tested unchanged and is skipped
+    vector<int> lastChange(rows, 0);
+    int rounds = 0, pass = 0, total;
+    do
+    {
+        total = 0;
+        for (int field = 0; field < 4; ++field, ++pass)
+        {
+            // rows py, py + 2, ... and columns px, px + 2, ... of the interior
+            const int py = 1 + field / 2, px = 1 + field % 2, count = (rows - py) / 2;
+            vector<int> deleted(count, 0);
+            parallel_for_(Range(0, count), [&](const Range &r)
+            {
+                for (int t = r.start; t < r.end; ++t)
+                {
+                    const int y = py + 2 * t;
+                    if (pass >= 4 && max(lastChange[y - 1], max(lastChange[y], lastChange[y + 1])) < pass - 4)
+                        continue;
+                    uchar *p = im.ptr<uchar>(y);
+                    for (int x = px; x < cols - 1; x += 2)
+                        if (p[x] && rule.matches(0, true, neighbourCode(p + x, im.step)))
+                        {
+                            p[x] = 0;
+                            ++deleted[t];
+                        }
+                    if (deleted[t])
+                        lastChange[y] = pass;
+                }
+            });
+            for (int d : deleted)
+                total += d;
+        }
+        ++rounds;
+        if (onRound && !onRound(rounds, total))
+            break;
+    } while (total > 0);
+    return rounds;
+}
+
+// Subfield thinning at 1, 2, 4, ... threads on a size x size synthetic blob
+// mask; the results must all match, and the speed-up is against the
+// 1-thread run. Serial Golay thinning is timed alongside for reference
+// only: it deletes by a different rule, so it is not the same work.
+static void thinningBenchmark(int size)
+{
+    static const HitMiss3x3 golay(Golay, 8);
+    Mat mask = synth::render(synth::blobs(size, size, max(1, size / 200 * (size / 200)), 15, 40, 1));
+    cout << "Thinning benchmark, " << size << "x" << size << " mask, "
+         << countNonZero(mask) << " foreground pixels" << endl;
+    auto timed = [](const function<void()> &f)
+    {
+        auto t0 = chrono::steady_clock::now();
+        f();
+        return chrono::duration<double, milli>(chrono::steady_clock::now() - t0).count();
+    };
+
+    Mat serial = mask.clone();
+    int rounds = 0;
+    const double ts = timed([&] { rounds = thinBorderQueue(serial, golay); });
+    cout << "  serial Golay (reference): " << ts << " ms, " << rounds << " rounds, "
+         << countNonZero(serial) << " skeleton pixels" << endl;
+
+    const int maxThreads = getNumThreads();
+    Mat first;
+    double t1 = 0;
+    for (int threads = 1;; threads = min(2 * threads, maxThreads))
+    {
+        setNumThreads(threads);
+        Mat im = mask.clone();
+        const double t = timed([&] { rounds = thinSubfields(im); });
+        const bool same = first.empty() || norm(im, first, NORM_INF) == 0;
+        if (first.empty())
+        {
+            first = im;
+            t1 = t;
+        }
+        cout << "  subfields, " << threads << " thread(s): " << t << " ms, " << rounds << " rounds, "
+             << countNonZero(im) << " skeleton pixels, x" << t1 / t << " vs 1 thread"
+             << (same ? "" : "  RESULT DIFFERS") << endl;
+        if (threads >= maxThreads)
+            break;
+    }
+    setNumThreads(maxThreads);
+}
+
+// ---------- Exact Euclidean distance transform ----------
+// Felzenszwalb-Huttenlocher: the squared distance separates into a 1-D pass
+// along the rows (plain nearest-zero distance in the row) followed by a 1-D
+// lower envelope of parabolas along the columns. Both passes run over
+// contiguous lines in parallel; the column pass works on a transposed copy,
+// made with blocked transposes so neither side walks memory by whole rows.
+// Squared distances are integers kept in 32 bits, which limits the image to
+// 46340 x 46340.
+static const uint32_t EDT_INF = UINT32_MAX;
+
+template <class T>
+static void transposeBlocked(const T *src, T *dst, int rows, int cols)
+{
+    const int B = 64;
+    parallel_for_(Range(0, (rows + B - 1) / B), [&](const Range &r)
+    {
+        for (int by = r.start * B; by < min(rows, r.end * B); by += B)
+            for (int bx = 0; bx < cols; bx += B)
+                for (int y = by; y < min(rows, by + B); ++y)
+                    for (int x = bx; x < min(cols, bx + B); ++x)
+                        dst[size_t(x) * rows + y] = src[size_t(y) * cols + x];
+    });
+}
+
+// Lower envelope of the parabolas (q - i)^2 + f[i] over one line of n values
+// (EDT_INF = no parabola): d[q] = min_i, and at[q] = the minimising i
+static void edtEnvelope(const uint32_t *f, int n, uint32_t *d, int *at, int *v, double *z)
+{
+    int k = -1;
+    for (int q = 0; q < n; ++q)
+    {
+        if (f[q] == EDT_INF)
+            continue;
+        const double fq = double(f[q]) + double(q) * q;
+        double s = -DBL_MAX;
+        while (k >= 0)
+        {
+            s = (fq - (double(f[v[k]]) + double(v[k]) * v[k])) / (2.0 * (q - v[k]));
+            if (s > z[k])
+                break;
+            --k;
+        }
+        ++k;
+        v[k] = q;
+        z[k] = k ? s : -DBL_MAX;
+    }
+    if (k < 0)
+    {
+        for (int q = 0; q < n; ++q)
+        {
+            d[q] = EDT_INF;
+            at[q] = -1;
+        }
+        return;
+    }
+    z[k + 1] = DBL_MAX;
+    for (int q = 0, j = 0; q < n; ++q)
+    {
+        while (z[j + 1] < q)
+            ++j;
+        const int64_t dq = q - v[j];
+        d[q] = uint32_t(dq * dq + f[v[j]]);
+        at[q] = v[j];
+    }
+}
+
+// Exact distance of every nonzero pixel of bin to the nearest zero pixel,
+// like distanceTransform(DIST_L2, DIST_MASK_PRECISE). dtype CV_32F gives the
+// distance (or its square with `squared`), CV_16U the squared distance
+// saturated at 65535. With `labels`, a CV_32S image of the nearest zero
+// pixel of each pixel as y * cols + x (-1 if bin has no zero pixel).
+static void exactDistanceTransform(const Mat &bin, Mat &dist, int dtype = CV_32F, bool squared = false,
+                                   Mat *labels = nullptr)
+{
+    CV_Assert(bin.type() == CV_8UC1 && (dtype == CV_32F || dtype == CV_16U));
+    CV_Assert(bin.rows <= 46340 && bin.cols <= 46340);
+    const int rows = bin.rows, cols = bin.cols;
+    const size_t total = size_t(rows) * cols;
+
+    // pass 1, along rows: squared distance to the nearest zero in the row
+    vector<uint32_t> g(total), gt(total), dt(total);
+    vector<int> nearX(labels ? total : 0), nearYt(total);
+    parallel_for_(Range(0, rows), [&](const Range &r)
+    {
+        for (int y = r.start; y < r.end; ++y)
+        {
+            const uchar *p = bin.ptr<uchar>(y);
+            uint32_t *gy = &g[size_t(y) * cols];
+            int *ny = labels ? &nearX[size_t(y) * cols] : nullptr;
+            int last = -1;
+            for (int x = 0; x < cols; ++x)
+            {
+                if (!p[x])
+                    last = x;
+                gy[x] = last < 0 ? EDT_INF : uint32_t(x - last);
+                if (ny)
+                    ny[x] = last;
+            }
+            last = -1;
+            for (int x = cols - 1; x >= 0; --x)
+            {
+                if (!p[x])
+                    last = x;
+                if (last >= 0 && uint32_t(last - x) < gy[x])
+                {
+                    gy[x] = uint32_t(last - x);
+                    if (ny)
+                        ny[x] = last;
+                }
+            }
+            for (int x = 0; x < cols; ++x)
+                if (gy[x] != EDT_INF)
+                    gy[x] *= gy[x];
+        }
+    });
+
+    // pass 2, along columns of the transposed image: lower envelope
+    transposeBlocked(&g[0], &gt[0], rows, cols);
+    parallel_for_(Range(0, cols), [&](const Range &r)
+    {
+        vector<int> v(rows);
+        vector<double> z(rows + 1);
+        for (int x = r.start; x < r.end; ++x)
+            edtEnvelope(&gt[size_t(x) * rows], rows, &dt[size_t(x) * rows], &nearYt[size_t(x) * rows], &v[0], &z[0]);
+    });
+    transposeBlocked(&dt[0], &g[0], cols, rows);
+    vector<int> nearY(labels ? total : 0);
+    if (labels)
+        transposeBlocked(&nearYt[0], &nearY[0], cols, rows);
+
+    dist.create(rows, cols, dtype);
+    if (labels)
+        labels->create(rows, cols, CV_32S);
+    parallel_for_(Range(0, rows), [&](const Range &r)
+    {
+        for (int y = r.start; y < r.end; ++y)
+        {
+            const uint32_t *d = &g[size_t(y) * cols];
+            if (dtype == CV_16U)
+            {
+                ushort *o = dist.ptr<ushort>(y);
+                for (int x = 0; x < cols; ++x)
+                    o[x] = ushort(min<uint32_t>(d[x], 65535));
+            }
+            else
+            {
+                float *o = dist.ptr<float>(y);
+                for (int x = 0; x < cols; ++x)
+                    o[x] = d[x] == EDT_INF ? FLT_MAX : squared ? float(d[x]) : sqrt(float(d[x]));
+            }
+            if (labels)
+            {
+                int *l = labels->ptr<int>(y);
+                for (int x = 0; x < cols; ++x)
+                {
+                    const int ny = nearY[size_t(y) * cols + x];
+                    l[x] = ny < 0 ? -1 : ny * cols + nearX[size_t(ny) * cols + x];
+                }
+            }
+        }
+    });
+}
+
+// ---------- Morphological reconstruction ----------
+// Vincent's hybrid algorithm for reconstruction by dilation (marker <= mask):
+// a raster scan and an anti-raster scan propagate the marker under the mask
+// over most of the image, and the pixels that can still grow go into a FIFO
+// that finishes the job. Two passes plus the queue work, whatever the
+// geodesic distances are. The images are padded by one pixel of the lowest
+// value, which never propagates, so the scans need no bounds checks.
+template <class T>
+static void reconstructPadded(Mat &J, const Mat &I, int connectivity)
+{
+    const int rows = J.rows, cols = J.cols, s = cols;
+    T *j = J.ptr<T>();
+    const T *m = I.ptr<T>();
+    // neighbours that come before a pixel in raster order
+    const int pre8[4] = {-1, -s - 1, -s, -s + 1}, pre4[2] = {-1, -s};
+    const int *pre = connectivity == 8 ? pre8 : pre4, np = connectivity == 8 ? 4 : 2;
+
+    for (int y = 1; y < rows - 1; ++y)
+        for (int i = y * s + 1; i < y * s + cols - 1; ++i)
+        {
+            T v = j[i];
+            for (int k = 0; k < np; ++k)
+                v = max(v, j[i + pre[k]]);
+            j[i] = min(v, m[i]);
+        }
+
+    queue<int> fifo;
+    for (int y = rows - 2; y >= 1; --y)
+        for (int i = y * s + cols - 2; i > y * s; --i)
+        {
+            T v = j[i];
+            for (int k = 0; k < np; ++k)
+                v = max(v, j[i - pre[k]]);
+            j[i] = v = min(v, m[i]);
+            for (int k = 0; k < np; ++k)
+            {
+                const int q = i - pre[k];
+                if (j[q] < v && j[q] < m[q])
+                {
+                    fifo.push(i);
+                    break;
+                }
+            }
+        }
+
+    while (!fifo.empty())
+    {
+        const int p = fifo.front();
+        fifo.pop();
+        for (int k = 0; k < 2 * np; ++k)
+        {
+            const int q = p + (k < np ? pre[k] : -pre[k - np]);
+            if (j[q] < j[p] && m[q] != j[q])
+            {
+                j[q] = min(j[p], m[q]);
+                fifo.push(q);
+            }
+        }
+    }
+}
+
+// Reconstruction by dilation of marker under mask (8U, 16U or 32F, one
+// channel); the marker is clipped to the mask first
+static void reconstructByDilation(const Mat &marker, const Mat &mask, Mat &dst, int connectivity = 8)
+{
+    CV_Assert(marker.size() == mask.size() && marker.type() == mask.type() && mask.channels() == 1);
+    CV_Assert(mask.depth() == CV_8U || mask.depth() == CV_16U || mask.depth() == CV_32F);
+    CV_Assert(connectivity == 4 || connectivity == 8);
+    CV_Assert((mask.rows + 2.0) * (mask.cols + 2.0) < INT_MAX);
+    const Scalar lowest = Scalar::all(mask.depth() == CV_32F ? -FLT_MAX : 0);
+    Mat clipped, J, I;
+    cv::min(marker, mask, clipped);
+    copyMakeBorder(clipped, J, 1, 1, 1, 1, BORDER_CONSTANT, lowest);
+    copyMakeBorder(mask, I, 1, 1, 1, 1, BORDER_CONSTANT, lowest);
+    if (mask.depth() == CV_8U)
+        reconstructPadded<uchar>(J, I, connectivity);
+    else if (mask.depth() == CV_16U)
+        reconstructPadded<ushort>(J, I, connectivity);
+    else
+        reconstructPadded<float>(J, I, connectivity);
+    J(Rect(1, 1, mask.cols, mask.rows)).copyTo(dst);
+}
+
+// value order reversed (255 - v, 65535 - v or -v), which turns erosion into dilation
+static Mat invertValues(const Mat &m)
+{
+    Mat r;
+    if (m.depth() == CV_32F)
+        m.convertTo(r, -1, -1);
+    else
+        bitwise_not(m, r);
+    return r;
+}
+
+// Reconstruction by erosion of marker over mask (marker >= mask)
+static void reconstructByErosion(const Mat &marker, const Mat &mask, Mat &dst, int connectivity = 8)
+{
+    reconstructByDilation(invertValues(marker), invertValues(mask), dst, connectivity);
+    dst = invertValues(dst);
+}
+
+// Background pixels that the image border cannot reach (through
+// 4-connected background, the dual of 8-connected objects) become foreground
+static void fillHoles(const Mat &bin, Mat &dst)
+{
+    CV_Assert(bin.type() == CV_8UC1);
+    Mat bg, marker = Mat::zeros(bin.size(), CV_8UC1), reached;
+    compare(bin, Scalar::all(0), bg, CMP_EQ);
+    const int w = bin.cols, h = bin.rows;
+    for (Rect r : {Rect(0, 0, w, 1), Rect(0, h - 1, w, 1), Rect(0, 0, 1, h), Rect(w - 1, 0, 1, h)})
+        bg(r).copyTo(marker(r));
+    reconstructByDilation(marker, bg, reached, 4);
+    bitwise_not(reached, dst);
 }
-static inline void setBlack(Mat &im, int x, int y)
+
+// h-maxima transform: every maximum lower than h above its surroundings is
+// flattened, the rest are lowered by h
+static void hMaxima(const Mat &im, double h, Mat &dst, int connectivity = 8)
+{
+    Mat marker;
+    subtract(im, Scalar::all(h), marker);
+    reconstructByDilation(marker, im, dst, connectivity);
+}
+
+static void hMinima(const Mat &im, double h, Mat &dst, int connectivity = 8)
+{
+    Mat marker;
+    add(im, Scalar::all(h), marker);
+    reconstructByErosion(marker, im, dst, connectivity);
+}
+
+// 255 on the plateaus that no higher (lower) neighbour touches, integer
+// images. The h = 1 marker saturates, so a plateau at 0 is never reported
+// as a maximum, nor one at the top value (255 / 65535) as a minimum; that
+// only matters for an image that is that value everywhere.
+static void regionalMaxima(const Mat &im, Mat &dst, int connectivity = 8)
+{
+    CV_Assert(im.depth() == CV_8U || im.depth() == CV_16U);
+    Mat rec;
+    hMaxima(im, 1, rec, connectivity);
+    compare(im, rec, dst, CMP_GT);
+}
+
+static void regionalMinima(const Mat &im, Mat &dst, int connectivity = 8)
+{
+    CV_Assert(im.depth() == CV_8U || im.depth() == CV_16U);
+    Mat rec;
+    hMinima(im, 1, rec, connectivity);
+    compare(im, rec, dst, CMP_LT);
+}
+
+// ---------- Medial axis from the distance transform ----------
+// Integer medial axis (Hesselink & Roerdink): two 4-neighbouring foreground
+// pixels p, q whose nearest background pixels fp, fq lie apart straddle a
+// ridge of the distance map, and whichever of them is nearer to the
+// bisector of fp and fq is on the axis. Every pixel checks its own 4
+// neighbours, so it is one parallel pass over the feature transform and
+// the cost does not grow with object thickness like thinning does.
+// Pairs with |fp - fq|^2 <= minSpread are skipped: the boundary noise
+// branches come from nearby feature pairs, and a larger value prunes more.
+// radius (CV_32F, optional) is the distance to the background on the axis,
+// the radius of the maximal disc centred there, and 0 elsewhere.
+static void medialAxis(const Mat &bin, Mat &axis, Mat *radius = nullptr, int minSpread = 4)
+{
+    Mat sq, labels;
+    exactDistanceTransform(bin, sq, CV_32F, true, &labels);
+    const int rows = bin.rows, cols = bin.cols;
+    axis.create(bin.size(), CV_8UC1);
+    if (radius)
+        radius->create(bin.size(), CV_32F);
+    parallel_for_(Range(0, rows), [&](const Range &r)
+    {
+        const int dx[4] = {1, -1, 0, 0}, dy[4] = {0, 0, 1, -1};
+        for (int y = r.start; y < r.end; ++y)
+        {
+            const uchar *b = bin.ptr<uchar>(y);
+            const int *f = labels.ptr<int>(y);
+            uchar *a = axis.ptr<uchar>(y);
+            for (int x = 0; x < cols; ++x)
+            {
+                bool on = false;
+                if (b[x] && f[x] >= 0)
+                {
+                    const int fpx = f[x] % cols, fpy = f[x] / cols;
+                    for (int k = 0; k < 4 && !on; ++k)
+                    {
+                        const int qx = x + dx[k], qy = y + dy[k];
+                        if (qx < 0 || qx >= cols || qy < 0 || qy >= rows || !bin.at<uchar>(qy, qx))
+                            continue;
+                        const int fq = labels.at<int>(qy, qx), fqx = fq % cols, fqy = fq / cols;
+                        const int64_t ex = fqx - fpx, ey = fqy - fpy;
+                        if (ex * ex + ey * ey <= minSpread)
+                            continue;
+                        // (fq - fp) . (fq + fp - p - q) <= 0: p is the one nearer the bisector
+                        on = ex * (fqx + fpx - x - qx) + ey * (fqy + fpy - y - qy) <= 0;
+                    }
+                }
+                a[x] = on ? 255 : 0;
+                if (radius)
+                    radius->at<float>(y, x) = on ? sqrt(sq.at<float>(y, x)) : 0.f;
+            }
+        }
+    });
+}
+
+// The shape back from its medial axis: the union of the discs of the axis
+// pixels, pixel x inside when |x - s|^2 < radius(s)^2 (strictly, as the
+// disc stops short of the nearest background pixel)
+static void reconstructFromAxis(const Mat &axis, const Mat &radius, Mat &dst)
 {
-    im.at<uchar>(y, x) = 0;
+    dst = Mat::zeros(axis.size(), CV_8UC1);
+    for (int y = 0; y < axis.rows; ++y)
+        for (int x = 0; x < axis.cols; ++x)
+        {
+            if (!axis.at<uchar>(y, x))
+                continue;
+            const float r = radius.at<float>(y, x);
+            const int d2 = cvRound(r * r), ri = int(r);
+            for (int j = max(0, y - ri); j <= min(axis.rows - 1, y + ri); ++j)
+            {
+                const int rem = d2 - 1 - (j - y) * (j - y);
+                if (rem < 0)
+                    continue;
+                const int w = int(sqrt(double(rem)));
+                uchar *o = dst.ptr<uchar>(j);
+                for (int i = max(0, x - w); i <= min(axis.cols - 1, x + w); ++i)
+                    o[i] = 255;
+            }
+        }
+}
+
+// ---------- Skeleton graph ----------
+// A thinned image as a graph, built in one pass. A skeleton pixel leaving
+// 1 branch (0->1 transitions around its ring) is an end point, 2 a path
+// pixel and 3 or more (or 0, inside a blob) a junction; touching junction
+// pixels form one node. Edges are walked from the nodes along the path
+// pixels, each pixel once, and kept as Freeman chain codes in one shared
+// buffer: code d steps by (CHAIN_DX[d], CHAIN_DY[d]), 0 is east and the
+// codes turn counter-clockwise.
+static const int CHAIN_DX[8] = {1, 1, 0, -1, -1, -1, 0, 1};
+static const int CHAIN_DY[8] = {0, -1, -1, -1, 0, 1, 1, 1};
+
+static inline int chainCode(int dx, int dy)
+{
+    for (int d = 0; d < 8; ++d)
+        if (CHAIN_DX[d] == dx && CHAIN_DY[d] == dy)
+            return d;
+    return -1;
+}
+
+class SkeletonGraph
+{
+public:
+    struct Node
+    {
+        Point pos;        // first pixel in raster order
+        int first, count; // its pixels: pixels[first .. first + count)
+        int degree = 0;   // edge ends, a loop counts twice
+        bool removed = false;
+    };
+    struct Edge
+    {
+        int from, to;     // node indices, from == to for a loop
+        Point start, end; // first and last pixel, on the nodes
+        int code, steps;  // chain codes: codes[code .. code + steps)
+        double length;    // 1 per straight and sqrt(2) per diagonal step
+        float meanRadius; // mean radius over the steps + 1 pixels
+        bool removed = false;
+    };
+
+    vector<Node> nodes;
+    vector<Edge> edges;
+    vector<uchar> codes;  // chain codes of all edges
+    vector<Point> pixels; // pixels of all nodes
+
+    // skel: thinned CV_8UC1, nonzero is skeleton; radius: optional CV_32F
+    // radius per pixel, e.g. the distance map of the shape
+    explicit SkeletonGraph(const Mat &skel, const Mat &radius = Mat());
+
+    // Removes spurs, edges from an end point to a junction shorter than
+    // minLength, shortest first. A junction left with two edges is merged
+    // away, so the longest branch at a junction survives. Only the graph is
+    // touched. Returns the number of spurs removed.
+    int pruneSpurs(double minLength);
+
+    // the edges and nodes left, 255 on zeros
+    void draw(Mat &dst, Size size) const;
+
+private:
+    int addEdge(int from, int to, Point start, Point end, const vector<uchar> &chain, double length, float meanRadius);
+};
+
+SkeletonGraph::SkeletonGraph(const Mat &skel, const Mat &radius)
+{
+    CV_Assert(skel.type() == CV_8UC1);
+    CV_Assert(radius.empty() || (radius.type() == CV_32F && radius.size() == skel.size()));
+    // branches per neighbour code, as 0->1 transitions clockwise from north-west
+    static const struct Branches
+    {
+        uchar n[256];
+        Branches()
+        {
+            static const int ring[8] = {0, 1, 2, 4, 7, 6, 5, 3};
+            for (int code = 0; code < 256; ++code)
+            {
+                int t = 0;
+                for (int k = 0; k < 8; ++k)
+                    t += !((code >> ring[k]) & 1) && ((code >> ring[(k + 1) % 8]) & 1);
+                n[code] = uchar(t);
+            }
+        }
+    } branches;
+
+    // 1-pixel zero frame so every skeleton pixel has 8 neighbours
+    Mat pad;
+    copyMakeBorder(skel, pad, 1, 1, 1, 1, BORDER_CONSTANT, Scalar(0));
+    const int W = pad.cols;
+    const size_t step = pad.step;
+    const uchar *P = pad.data;
+    const int offset[8] = {1, 1 - W, -W, -1 - W, -1, W - 1, W, W + 1}; // by chain code
+    auto pixel = [&](int i) { return Point(i % W - 1, i / W - 1); };
+    auto radiusAt = [&](int i) { return radius.empty() ? 0.f : radius.at<float>(i / W - 1, i % W - 1); };
+
+    // kind: 0 background, 1 end point, 2 path, 3 junction
+    vector<uchar> kind(pad.total(), 0);
+    parallel_for_(Range(1, pad.rows - 1), [&](const Range &r)
+    {
+        for (int y = r.start; y < r.end; ++y)
+            for (int x = 1; x < W - 1; ++x)
+            {
+                const int i = y * W + x;
+                if (!P[i])
+                    continue;
+                const uchar code = neighbourCode(P + i, step);
+                const int b = branches.n[code];
+                // an isolated pixel is a node without edges
+                kind[i] = uchar(b == 1 || !code ? 1 : b == 2 ? 2 : 3);
+            }
+    });
+
+    // nodes in raster order of their first pixel; junction pixels flood-filled
+    vector<int> nodeOf(pad.total(), -1), stack;
+    auto newNode = [&](int i)
+    {
+        Node n;
+        n.pos = pixel(i);
+        n.first = int(pixels.size());
+        n.count = 1;
+        pixels.push_back(n.pos);
+        nodeOf[i] = int(nodes.size());
+        nodes.push_back(n);
+        return nodeOf[i];
+    };
+    for (int i = 0; i < int(pad.total()); ++i)
+    {
+        if (!kind[i] || kind[i] == 2 || nodeOf[i] >= 0)
+            continue;
+        const int id = newNode(i);
+        if (kind[i] != 3)
+            continue;
+        stack.push_back(i);
+        while (!stack.empty())
+        {
+            const int j = stack.back();
+            stack.pop_back();
+            for (int d = 0; d < 8; ++d)
+            {
+                const int k = j + offset[d];
+                if (kind[k] == 3 && nodeOf[k] < 0)
+                {
+                    nodeOf[k] = id;
+                    pixels.push_back(pixel(k));
+                    ++nodes[id].count;
+                    stack.push_back(k);
+                }
+            }
+        }
+    }
+
+    // follow the path pixels from node pixel s through its neighbour s + offset[d]
+    vector<uchar> visited(pad.total(), 0), chain;
+    auto walk = [&](int s, int d)
+    {
+        chain.assign(1, uchar(d));
+        const int from = nodeOf[s];
+        double length = (d & 1) ? CV_SQRT2 : 1.0, rsum = radiusAt(s);
+        int prev = s, cur = s + offset[d];
+        while (nodeOf[cur] < 0)
+        {
+            visited[cur] = 1;
+            rsum += radiusAt(cur);
+            // next: another node, then an unvisited path pixel, 4-neighbours
+            // first; the start node only if nothing else is left
+            int best = -1, bestRank = INT_MAX;
+            for (int k = 0; k < 8; ++k)
+            {
+                const int j = cur + offset[k];
+                if (j == prev || !kind[j] || (nodeOf[j] < 0 && visited[j]))
+                    continue;
+                int rank = (k & 1) + (nodeOf[j] < 0 ? 2 : 0);
+                if (nodeOf[j] == from && chain.size() == 1)
+                    rank += 4;
+                if (rank < bestRank)
+                {
+                    best = k;
+                    bestRank = rank;
+                }
+            }
+            if (best < 0)
+            {
+                // dead end (odd thinning leftovers): end the edge on a new node
+                newNode(cur);
+                rsum -= radiusAt(cur);
+                break;
+            }
+            chain.push_back(uchar(best));
+            length += (best & 1) ? CV_SQRT2 : 1.0;
+            prev = cur;
+            cur += offset[best];
+        }
+        rsum += radiusAt(cur);
+        addEdge(from, nodeOf[cur], pixel(s), pixel(cur), chain, length, float(rsum / (chain.size() + 1)));
+    };
+
+    set<pair<int, int>> linked;
+    for (int s = 0; s < int(pad.total()); ++s)
+    {
+        if (nodeOf[s] < 0)
+            continue;
+        for (int d = 0; d < 8; ++d)
+        {
+            const int n = s + offset[d];
+            if (kind[n] == 2 && nodeOf[n] < 0 && !visited[n])
+                walk(s, d);
+            else if (nodeOf[n] >= 0 && nodeOf[n] != nodeOf[s] && n > s)
+            {
+                // neighbouring nodes: one edge per pair
+                if (linked.insert(make_pair(min(nodeOf[s], nodeOf[n]), max(nodeOf[s], nodeOf[n]))).second)
+                    addEdge(nodeOf[s], nodeOf[n], pixel(s), pixel(n), vector<uchar>(1, uchar(d)),
+                            (d & 1) ? CV_SQRT2 : 1.0, (radiusAt(s) + radiusAt(n)) / 2);
+            }
+        }
+    }
+    // closed loops without a node: a node on their first pixel
+    for (int s = 0; s < int(pad.total()); ++s)
+        if (kind[s] == 2 && !visited[s] && nodeOf[s] < 0)
+        {
+            newNode(s);
+            for (int d = 0; d < 8; ++d)
+                if (kind[s + offset[d]] && !visited[s + offset[d]] && nodeOf[s + offset[d]] < 0)
+                    walk(s, d);
+        }
+}
+
+int SkeletonGraph::addEdge(int from, int to, Point start, Point end, const vector<uchar> &chain, double length,
+                           float meanRadius)
+{
+    Edge e;
+    e.from = from;
+    e.to = to;
+    e.start = start;
+    e.end = end;
+    e.code = int(codes.size());
+    e.steps = int(chain.size());
+    e.length = length;
+    e.meanRadius = meanRadius;
+    codes.insert(codes.end(), chain.begin(), chain.end());
+    edges.push_back(e);
+    ++nodes[from].degree;
+    ++nodes[to].degree;
+    return int(edges.size()) - 1;
+}
+
+int SkeletonGraph::pruneSpurs(double minLength)
+{
+    vector<vector<int>> incident(nodes.size());
+    for (int i = 0; i < int(edges.size()); ++i)
+        if (!edges[i].removed)
+        {
+            incident[edges[i].from].push_back(i);
+            if (edges[i].to != edges[i].from)
+                incident[edges[i].to].push_back(i);
+        }
+    auto isSpur = [&](const Edge &e)
+    {
+        if (e.removed || e.from == e.to || e.length >= minLength)
+            return false;
+        const int a = nodes[e.from].degree, b = nodes[e.to].degree;
+        return (a == 1 && b >= 3) || (b == 1 && a >= 3);
+    };
+    // chain of e as seen from its `to` end
+    auto reversed = [&](const Edge &e)
+    {
+        vector<uchar> c(e.steps);
+        for (int k = 0; k < e.steps; ++k)
+            c[k] = uchar((codes[e.code + e.steps - 1 - k] + 4) & 7);
+        return c;
+    };
+
+    priority_queue<pair<double, int>, vector<pair<double, int>>, greater<pair<double, int>>> queue;
+    for (int i = 0; i < int(edges.size()); ++i)
+        if (isSpur(edges[i]))
+            queue.push(make_pair(edges[i].length, i));
+
+    int removedSpurs = 0;
+    while (!queue.empty())
+    {
+        const int i = queue.top().second;
+        queue.pop();
+        if (!isSpur(edges[i]))
+            continue;
+        Edge &spur = edges[i];
+        spur.removed = true;
+        ++removedSpurs;
+        const int tip = nodes[spur.from].degree == 1 ? spur.from : spur.to, v = spur.from + spur.to - tip;
+        nodes[tip].degree = 0;
+        nodes[tip].removed = true;
+        if (--nodes[v].degree != 2)
+            continue;
+
+        // v is now on a path: merge its two edges a -> v -> b into one
+        int e1 = -1, e2 = -1;
+        for (int j : incident[v])
+            if (!edges[j].removed)
+                (e1 < 0 ? e1 : e2) = j;
+        if (e2 < 0)
+            continue; // a loop through v
+        const Edge a = edges[e1], b = edges[e2];
+        vector<uchar> chain = a.to == v ? vector<uchar>(codes.begin() + a.code, codes.begin() + a.code + a.steps)
+                                        : reversed(a);
+        Point p = a.to == v ? a.end : a.start;
+        const Point q = b.from == v ? b.start : b.end;
+        double length = a.length + b.length;
+        // the two edges can meet v at different pixels of a junction
+        // cluster: bridge them with a shortest path through the cluster
+        if (p != q)
+        {
+            const Point *px = &pixels[nodes[v].first];
+            const int n = nodes[v].count;
+            vector<int> parent(n, -1);
+            vector<int> order(1, int(find(px, px + n, q) - px));
+            parent[order[0]] = order[0];
+            for (size_t k = 0; k < order.size() && px[order.back()] != p; ++k)
+                for (int j = 0; j < n; ++j)
+                {
+                    const Point d = px[j] - px[order[k]];
+                    if (parent[j] < 0 && abs(d.x) <= 1 && abs(d.y) <= 1)
+                    {
+                        parent[j] = order[k];
+                        order.push_back(j);
+                    }
+                }
+            // walk back from p towards q
+            for (int j = int(find(px, px + n, p) - px); px[j] != q; j = parent[j])
+            {
+                const Point d = px[parent[j]] - px[j];
+                chain.push_back(uchar(chainCode(d.x, d.y)));
+                length += d.x && d.y ? CV_SQRT2 : 1.0;
+            }
+        }
+        const vector<uchar> tail = b.from == v
+                                       ? vector<uchar>(codes.begin() + b.code, codes.begin() + b.code + b.steps)
+                                       : reversed(b);
+        chain.insert(chain.end(), tail.begin(), tail.end());
+        const int from = a.to == v ? a.from : a.to, to = b.from == v ? b.to : b.from;
+        const float meanRadius = float((a.meanRadius * (a.steps + 1) + b.meanRadius * (b.steps + 1)) /
+                                       (a.steps + b.steps + 2));
+        edges[e1].removed = edges[e2].removed = true;
+        nodes[v].degree = 0;
+        nodes[v].removed = true;
+        nodes[from].degree -= 1;
+        nodes[to].degree -= 1;
+        const int m = addEdge(from, to, a.to == v ? a.start : a.end, b.from == v ? b.end : b.start, chain, length,
+                              meanRadius);
+        replace(incident[from].begin(), incident[from].end(), e1, m);
+        if (to != from)
+            replace(incident[to].begin(), incident[to].end(), e2, m);
+        else
+            incident[to].erase(find(incident[to].begin(), incident[to].end(), e2));
+        if (isSpur(edges[m]))
+            queue.push(make_pair(edges[m].length, m));
+    }
+    return removedSpurs;
+}
+
+void SkeletonGraph::draw(Mat &dst, Size size) const
+{
+    dst = Mat::zeros(size, CV_8UC1);
+    for (const Edge &e : edges)
+    {
+        if (e.removed)
+            continue;
+        Point p = e.start;
+        dst.at<uchar>(p) = 255;
+        for (int k = 0; k < e.steps; ++k)
+        {
+            p += Point(CHAIN_DX[codes[e.code + k]], CHAIN_DY[codes[e.code + k]]);
+            dst.at<uchar>(p) = 255;
+        }
+    }
+    for (const Node &n : nodes)
+        if (!n.removed)
+            dst.at<uchar>(n.pos) = 255;
 }
 
 // ---------- Task 1: Distance Transform ----------
@@ -36,15 +1164,23 @@ void distanceTransformTask()
     if (im.empty())
         return;
 
+    // dark cores of the grey input, as a marker-controlled watershed would
+    // seed them: regional minima after h-minima drops the ones shallower
+    // than 20 levels (noise and texture)
+    Mat hmin, darkCores, labels;
+    hMinima(im, 20, hmin);
+    regionalMinima(hmin, darkCores);
+    cout << "Dark cores of the grey image (h = 20): " << connectedComponents(darkCores, labels) - 1 << endl;
+
     threshold(im, im, 128, 255, THRESH_BINARY);
 
-    Mat dist;
-    distanceTransform(im, dist, DIST_L2, 3, CV_32F);
+    // exact distances; the 3x3 approximation only for comparison
+    Mat dist, approx;
+    exactDistanceTransform(im, dist, CV_32F);
+    distanceTransform(im, approx, DIST_L2, 3, CV_32F);
+    cout << "Max error of the 3x3 distance transform: " << norm(dist, approx, NORM_INF) << endl;
     dist.convertTo(dist, CV_8U, 5, 0);
 
-    Mat se = getStructuringElement(MORPH_ELLIPSE, Size(5, 5));
-    Mat dilated = dist.clone();
-
     Mat grid;
     hconcat(im, dist, grid);
     putText(grid, "Original", Point(10, 30), FONT_HERSHEY_SIMPLEX, 0.8, Scalar(255), 2);
@@ -61,39 +1197,52 @@ void distanceTransformTask()
             break;
     }
 
-    // Show iterative dilation
-    for (int i = 0; i < 10; ++i)
-    {
-        Mat tmp;
-        dilate(dilated, tmp, se);
-        tmp.copyTo(dilated, dilated);
+    // Grow every distance peak over its object: reconstruction by dilation
+    // of the map under the object mask (each object takes its maximum),
+    // one call instead of repeated masked dilations
+    Mat grown;
+    reconstructByDilation(dist, im, grown);
 
-        hconcat(dist, dilated, grid);
-        putText(grid, "Distance", Point(10, 30), FONT_HERSHEY_SIMPLEX, 0.8, Scalar(255), 2);
-        putText(grid, "Dilated Map", Point(dist.cols + 10, 30), FONT_HERSHEY_SIMPLEX, 0.8, Scalar(255), 2);
+    hconcat(dist, grown, grid);
+    putText(grid, "Distance", Point(10, 30), FONT_HERSHEY_SIMPLEX, 0.8, Scalar(255), 2);
+    putText(grid, "Reconstructed Map", Point(dist.cols + 10, 30), FONT_HERSHEY_SIMPLEX, 0.8, Scalar(255), 2);
+    imshow("Task 1 - Distance Transform (SPACE=next, Q=quit)", grid);
+    while (true)
+    {
+        int key = waitKey(0);
+        if (key == 'q' || key == 'Q')
+            exit(0);
+        else if (key == ' ')
+            break;
+    }
 
-        imshow("Task 1 - Distance Transform (SPACE=next, Q=quit)", grid);
+    // object centres: maxima of the distance map at least 10 levels high,
+    // and the objects with their holes filled
+    Mat hmax, peaks, filled;
+    hMaxima(dist, 10, hmax);
+    regionalMaxima(hmax, peaks);
+    fillHoles(im, filled);
 
+    hconcat(filled, peaks, grid);
+    putText(grid, "Filled Holes", Point(10, 30), FONT_HERSHEY_SIMPLEX, 0.8, Scalar(255), 2);
+    putText(grid, "h-Maxima Peaks", Point(dist.cols + 10, 30), FONT_HERSHEY_SIMPLEX, 0.8, Scalar(255), 2);
+    imshow("Task 1 - Distance Transform (SPACE=next, Q=quit)", grid);
+    while (true)
+    {
         int key = waitKey(0);
         if (key == 'q' || key == 'Q')
             exit(0);
         else if (key == ' ')
-            continue;
+            break;
     }
 }
 
 // ---------- Task 2: Skeletonization using Golay Masks ----------
-void golaySkeletonTask()
-{
-    static const int Golay[72] = {
-        0, 0, 0, -1, 1, -1, 1, 1, 1,
-        -1, 0, 0, 1, 1, 0, -1, 1, -1,
-        1, -1, 0, 1, 1, 0, 1, -1, 0,
-        -1, 1, -1, 1, 1, 0, -1, 0, 0,
-        1, 1, 1, -1, 1, -1, 0, 0, 0,
-        -1, 1, -1, 0, 1, 1, 0, 0, -1,
-        0, -1, 1, 0, 1, 1, 0, -1, 1,
-        0, 0, -1, 0, 1, 1, -1, 1, -1};
+// parallel: deterministic subfield thinning instead of serial Golay (a
+// different deletion rule, so the skeleton can differ slightly)
+void golaySkeletonTask(bool parallel = false)
+{
+    static const HitMiss3x3 golay(Golay, 8), endpoints(Endpoint, 8);
 
     Mat imO = loadImage("pityoka.png", IMREAD_GRAYSCALE);
     if (imO.empty())
@@ -112,46 +1261,11 @@ void golaySkeletonTask()
             break;
     }
 
-    int count;
-    do
+    auto showRound = [&](int, int)
     {
-        count = 0;
-        for (int l = 0; l < 8; l++)
-        {
-            for (int y = 1; y < imO.rows - 1; y++)
-            {
-                for (int x = 1; x < imO.cols - 1; x++)
-                {
-                    if (getGray(imO, x, y) > 0)
-                    {
-                        bool erase = true;
-                        int index = 9 * l;
-                        for (int j = y - 1; j <= y + 1; j++)
-                        {
-                            for (int i = x - 1; i <= x + 1; i++)
-                            {
-                                int maskVal = Golay[index++];
-                                if ((maskVal == 1 && getGray(imO, i, j) == 0) ||
-                                    (maskVal == 0 && getGray(imO, i, j) > 0))
-                                {
-                                    erase = false;
-                                }
-                            }
-                        }
-                        if (erase)
-                        {
-                            setBlack(imP, x, y);
-                            count++;
-                        }
-                    }
-                }
-            }
-            imO = imP.clone();
-        }
-
         Mat grid;
         hconcat(imP, imO, grid);
-        putText(grid, "Current", Point(10, 30), FONT_HERSHEY_SIMPLEX, 0.8, Scalar(255), 2);
+        putText(grid, "Original", Point(10, 30), FONT_HERSHEY_SIMPLEX, 0.8, Scalar(255), 2);
         putText(grid, "Updated", Point(imP.cols + 10, 30), FONT_HERSHEY_SIMPLEX, 0.8, Scalar(255), 2);
 
         imshow("Task 2 - Golay Skeleton (SPACE=next, Q=quit)", grid);
@@ -159,15 +1273,79 @@ void golaySkeletonTask()
         int key = waitKey(100);
         if (key == 'q' || key == 'Q')
             exit(0);
-    } while (count > 0);
+        return true;
+    };
+    cout << "Thinning: " << (parallel ? "parallel subfields" : "serial Golay") << endl;
+    if (parallel)
+        thinSubfields(imO, showRound);
+    else
+        thinBorderQueue(imO, golay, showRound);
+
+    Mat ends;
+    endpoints.apply(imO, ends);
+    cout << "Skeleton end points: " << countNonZero(ends) << endl;
+
+    // the skeleton as a graph, with the object thickness along each branch
+    Mat dist;
+    exactDistanceTransform(imP, dist);
+    SkeletonGraph graph(imO, dist);
+    auto branchStats = [&](const char *what)
+    {
+        int branches = 0;
+        double length = 0, radius = 0;
+        for (const SkeletonGraph::Edge &e : graph.edges)
+            if (!e.removed)
+            {
+                ++branches;
+                length += e.length;
+                radius += e.meanRadius;
+            }
+        cout << what << ": " << branches << " branches, mean length " << (branches ? length / branches : 0)
+             << ", mean radius " << (branches ? radius / branches : 0) << endl;
+    };
+    branchStats("Skeleton graph");
+    int spurs = graph.pruneSpurs(10);
+    cout << "Pruned " << spurs << " spurs shorter than 10 pixels" << endl;
+    branchStats("Pruned graph");
+
+    // the medial axis in one pass, with the disc radius that rebuilds the shape
+    Mat axis, radius, rebuilt;
+    auto t0 = chrono::steady_clock::now();
+    medialAxis(imP, axis, &radius);
+    double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - t0).count();
+    reconstructFromAxis(axis, radius, rebuilt);
+    Mat diff;
+    bitwise_xor(rebuilt, imP, diff);
+    double maxR;
+    minMaxLoc(radius, nullptr, &maxR);
+    cout << "Medial axis: " << countNonZero(axis) << " pixels in " << ms << " ms, max radius " << maxR
+         << ", " << countNonZero(diff) << " pixels differ after reconstruction" << endl;
+
+    Mat radiusView, grid;
+    radius.convertTo(radiusView, CV_8U, maxR > 0 ? 255.0 / maxR : 0);
+    hconcat(imO, radiusView, grid);
+    hconcat(grid, rebuilt, grid);
+    putText(grid, "Golay", Point(10, 30), FONT_HERSHEY_SIMPLEX, 0.8, Scalar(255), 2);
+    putText(grid, "Medial axis (radius)", Point(imP.cols + 10, 30), FONT_HERSHEY_SIMPLEX, 0.8, Scalar(255), 2);
+    putText(grid, "Rebuilt from axis", Point(2 * imP.cols + 10, 30), FONT_HERSHEY_SIMPLEX, 0.8, Scalar(255), 2);
+    imshow("Task 2 - Golay Skeleton (SPACE=next, Q=quit)", grid);
 
     waitKey(0);
 }
 
 // ---------- Main ----------
-int main()
+int main(int argc, char **argv)
 {
+    // "bench [size]": thinning benchmark only
+    // "parallel": the skeleton task thins with parallel subfields
+    if (argc > 1 && string(argv[1]) == "bench")
+    {
+        thinningBenchmark(argc > 2 ? atoi(argv[2]) : 4096);
+        return 0;
+    }
+    const bool parallel = argc > 1 && string(argv[1]) == "parallel";
+
     distanceTransformTask();
-    golaySkeletonTask();
+    golaySkeletonTask(parallel);
     return 0;
 }
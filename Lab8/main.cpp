@@ -1,4 +1,7 @@
 #include <opencv2/opencv.hpp>
+#include <opencv2/core/hal/intrin.hpp>
+#include <chrono>
+#include <functional>
 #include <iostream>
 using namespace cv;
 using namespace std;
@@ -20,6 +23,16 @@ static Mat loadImage(const string &filename, int flags = IMREAD_COLOR)
     return Mat();
 }
 
+// ---------- Helper: 8-bit view of an 8- or 16-bit image for display ----------
+static Mat to8u(const Mat &im)
+{
+    if (im.depth() == CV_8U)
+        return im;
+    Mat view;
+    im.convertTo(view, CV_8U, 1.0 / 257);
+    return view;
+}
+
 // ---------- Helper: show image and wait for SPACE/Q ----------
 static bool waitSpaceOrQuit(const string &winname)
 {
@@ -33,10 +46,788 @@ static bool waitSpaceOrQuit(const string &winname)
     }
 }
 
+// ---------- Tone LUT ----------
+// 0..1 -> 0..1
+static float toneCurve(float v, float brightness, float contrast, float gamma)
+{
+    float vg = pow(max(v, 0.0f), 1.0f / max(gamma, 1e-6f));
+    float vc = contrast * (vg - 0.5f) + 0.5f;
+    float vb = vc + brightness;
+    return min(max(vb, 0.0f), 1.0f);
+}
+
+// The same curve for every channel, so the table is a single row.
+// CV_8U: 256 entries. CV_16U: 65536 entries (128 KB, exact, but the
+// lookups miss L1), or for segments < 65536 (a power of two) segments + 1
+// knots that applyToneLUT interpolates linearly. The gamma curve is
+// vertical at black, so the chords miss it in the shadows: with 256
+// segments the worst error is about 1 8-bit step at gamma 1.5, 4 at
+// gamma 2 and 45 at gamma 5 (4096 segments: 0.15 / 1 / 26). Short tables
+// are for previews only; final renders use the exact one.
+static void buildToneLUT(float brightness, float contrast, float gamma, Mat &lut, int depth = CV_8U,
+                         int segments = 65536)
+{
+    if (depth == CV_8U)
+    {
+        lut.create(1, 256, CV_8UC1);
+        for (int i = 0; i < 256; ++i)
+            lut.at<uchar>(0, i) = static_cast<uchar>(round(toneCurve(i / 255.0f, brightness, contrast, gamma) * 255.0f));
+        return;
+    }
+    CV_Assert(depth == CV_16U && segments >= 2 && segments <= 65536 && (segments & (segments - 1)) == 0);
+    const int n = segments == 65536 ? 65536 : segments + 1, step = 65536 / segments;
+    lut.create(1, n, CV_16UC1);
+    for (int i = 0; i < n; ++i)
+    {
+        const float v = min(i * step, 65535) / 65535.0f;
+        lut.at<ushort>(0, i) = static_cast<ushort>(round(toneCurve(v, brightness, contrast, gamma) * 65535.0f));
+    }
+}
+
+// CV_16U through a table from buildToneLUT, every channel alike
+static void applyLUT16(const Mat &in, const Mat &lut, Mat &out)
+{
+    CV_Assert(in.depth() == CV_16U && lut.type() == CV_16UC1 && lut.isContinuous());
+    const int n = int(lut.total());
+    int shift = 0;
+    while (n != 65536 && (65536 >> shift) > n - 1)
+        ++shift;
+    CV_Assert(n == 65536 || (shift > 0 && ((n - 1) << shift) == 65536));
+    const ushort *t = lut.ptr<ushort>();
+    out.create(in.size(), in.type());
+    parallel_for_(Range(0, in.rows), [&](const Range &r)
+    {
+        const int len = in.cols * in.channels(), mask = (1 << shift) - 1, half = (1 << shift) >> 1;
+        for (int y = r.start; y < r.end; ++y)
+        {
+            const ushort *s = in.ptr<ushort>(y);
+            ushort *d = out.ptr<ushort>(y);
+            if (n == 65536)
+                for (int i = 0; i < len; ++i)
+                    d[i] = t[s[i]];
+            else
+                for (int i = 0; i < len; ++i)
+                {
+                    const int j = s[i] >> shift, f = s[i] & mask;
+                    d[i] = ushort(t[j] + (((t[j + 1] - t[j]) * f + half) >> shift));
+                }
+        }
+    });
+}
+
+// 8-bit: the image viewed as one channel, so LUT does one lookup per byte
+static void applyToneLUT(const Mat &in, const Mat &lut, Mat &out)
+{
+    if (in.depth() == CV_16U)
+    {
+        applyLUT16(in, lut, out);
+        return;
+    }
+    Mat flat;
+    LUT(in.reshape(1), lut, flat);
+    out = flat.reshape(in.channels());
+}
+
+// ---------- Sampled image statistics ----------
+// Auto parameters only need a few percentiles, means and ranges, and those
+// can be estimated from a small sample of the pixels with a known error:
+//   SAMPLE_ALL         every pixel (the reference, one full pass)
+//   SAMPLE_ROWS        whole rows at a fixed stride, the cheapest to read
+//   SAMPLE_RANDOM      independent uniformly random pixels
+//   SAMPLE_BLUE_NOISE  one random pixel per cell of a grid (jittered
+//                      stratified sampling): even coverage without the
+//                      clumps and gaps of plain random samples
+enum SampleMode
+{
+    SAMPLE_ALL,
+    SAMPLE_ROWS,
+    SAMPLE_RANDOM,
+    SAMPLE_BLUE_NOISE
+};
+
+// Per-channel statistics of an 8- or 16-bit image, values in its own units.
+// The error bounds hold with 95 % confidence for random samples; the
+// blue-noise ones are stratified, which only tightens them. Pixels along a
+// row are strongly correlated, so strided rows count as one independent
+// sample per row and their bounds are conservative.
+struct ImageStats
+{
+    static const int BINS = 256; // 16-bit data is binned as v >> 8
+
+    int channels = 0;
+    double maxValue = 255;
+    bool exact = false;  // every pixel was read
+    int64 pixels = 0;    // pixels read
+    int64 effective = 0; // independent samples behind the bounds
+    vector<int64> hist;  // hist[c * BINS + bin]
+    double mean[4] = {}, stddev[4] = {}, minVal[4] = {}, maxVal[4] = {};
+
+    // value below which a fraction p of channel c lies, linear inside the
+    // bin; c < 0 pools all channels
+    double percentile(double p, int c = -1) const
+    {
+        const int c0 = c < 0 ? 0 : c, c1 = c < 0 ? channels : c + 1;
+        const double width = (maxValue + 1) / BINS;
+        const double target = min(max(p, 0.0), 1.0) * pixels * (c1 - c0);
+        double below = 0;
+        for (int b = 0; b < BINS; ++b)
+        {
+            int64 n = 0;
+            for (int k = c0; k < c1; ++k)
+                n += hist[k * BINS + b];
+            if (n > 0 && below + n >= target)
+                return min((b + (target - below) / n) * width, maxValue);
+            below += n;
+        }
+        return maxValue;
+    }
+
+    // Dvoretzky-Kiefer-Wolfowitz: the sample CDF is within this of the
+    // true one at every value
+    double cdfError() const { return exact ? 0.0 : sqrt(log(2.0 / 0.05) / (2.0 * max<int64>(effective, 1))); }
+
+    // the true p-percentile lies in [lo, hi]
+    void percentileBounds(double p, int c, double &lo, double &hi) const
+    {
+        lo = percentile(p - cdfError(), c);
+        hi = percentile(p + cdfError(), c);
+    }
+
+    // half-width of the interval around mean[c]
+    double meanError(int c) const { return exact ? 0.0 : 1.96 * stddev[c] / sqrt(double(max<int64>(effective, 1))); }
+
+    // at most this fraction of the pixels lies outside [minVal, maxVal]
+    // (rule of three: (1 - q)^n = 0.05 gives q ~ 3 / n)
+    double rangeMass() const { return exact ? 0.0 : min(1.0, 3.0 / max<int64>(effective, 1)); }
+};
+
+// Statistics of the sample picked by `mode`: about `budget` pixels (rows,
+// random or blue-noise) or all of them. Work is split into fixed units
+// (sampled rows, grid rows, chunks of random pixels), each with its own
+// seed, and the bands are merged in order, so the result does not depend
+// on the thread count.
+template <typename T>
+static void accumulateStats(const Mat &im, SampleMode mode, int budget, uint64 seed, ImageStats &st)
+{
+    struct Acc
+    {
+        vector<int64> hist;
+        double sum[4] = {}, sq[4] = {};
+        int lo[4] = {65535, 65535, 65535, 65535}, hi[4] = {};
+        int64 n = 0;
+    };
+    const int cn = im.channels(), rows = im.rows, cols = im.cols;
+    const int shift = sizeof(T) == 2 ? 8 : 0, chunk = 1024;
+    budget = max(budget, 1);
+
+    // units and the pixels each one covers
+    int units = rows, gx = 1, gy = 1;
+    if (mode == SAMPLE_ROWS)
+        units = min(rows, (budget + cols - 1) / cols);
+    else if (mode == SAMPLE_BLUE_NOISE)
+    {
+        gx = min(cols, max(1, cvRound(sqrt(double(budget) * cols / rows))));
+        gy = min(rows, max(1, budget / gx));
+        units = gy;
+    }
+    else if (mode == SAMPLE_RANDOM)
+        units = (budget + chunk - 1) / chunk;
+
+    const int bands = max(1, min(getNumThreads(), units));
+    vector<Acc> acc(bands);
+    parallel_for_(Range(0, bands), [&](const Range &r)
+    {
+        for (int b = r.start; b < r.end; ++b)
+        {
+            Acc &a = acc[b];
+            a.hist.assign(cn * ImageStats::BINS, 0);
+            auto add = [&](const T *p)
+            {
+                for (int c = 0; c < cn; ++c)
+                {
+                    const int v = p[c];
+                    ++a.hist[c * ImageStats::BINS + (v >> shift)];
+                    a.sum[c] += v;
+                    a.sq[c] += double(v) * v;
+                    a.lo[c] = min(a.lo[c], v);
+                    a.hi[c] = max(a.hi[c], v);
+                }
+                ++a.n;
+            };
+            for (int u = b * units / bands; u < (b + 1) * units / bands; ++u)
+            {
+                RNG rng(seed ^ (uint64(u + 1) * 0x9E3779B97F4A7C15ULL));
+                if (mode == SAMPLE_ALL || mode == SAMPLE_ROWS)
+                {
+                    // strided rows are centred in their stripes
+                    const int y = mode == SAMPLE_ALL ? u : int((2 * int64(u) + 1) * rows / (2 * units));
+                    const T *p = im.ptr<T>(y);
+                    for (int x = 0; x < cols; ++x, p += cn)
+                        add(p);
+                }
+                else if (mode == SAMPLE_BLUE_NOISE)
+                {
+                    const int y0 = u * rows / gy, y1 = (u + 1) * rows / gy;
+                    for (int i = 0; i < gx; ++i)
+                    {
+                        const int x0 = i * cols / gx, x1 = (i + 1) * cols / gx;
+                        add(im.ptr<T>(y0 + rng.uniform(0, y1 - y0)) + (x0 + rng.uniform(0, x1 - x0)) * cn);
+                    }
+                }
+                else
+                    for (int k = u * chunk; k < min(budget, (u + 1) * chunk); ++k)
+                        add(im.ptr<T>(rng.uniform(0, rows)) + rng.uniform(0, cols) * cn);
+            }
+        }
+    });
+
+    st.channels = cn;
+    st.maxValue = sizeof(T) == 2 ? 65535 : 255;
+    st.exact = mode == SAMPLE_ALL;
+    st.pixels = 0;
+    st.hist.assign(cn * ImageStats::BINS, 0);
+    double sum[4] = {}, sq[4] = {};
+    for (int c = 0; c < cn; ++c)
+    {
+        st.minVal[c] = st.maxValue;
+        st.maxVal[c] = 0;
+    }
+    for (const Acc &a : acc)
+    {
+        st.pixels += a.n;
+        for (size_t i = 0; i < st.hist.size(); ++i)
+            st.hist[i] += a.hist[i];
+        for (int c = 0; c < cn && a.n; ++c)
+        {
+            sum[c] += a.sum[c];
+            sq[c] += a.sq[c];
+            st.minVal[c] = min(st.minVal[c], double(a.lo[c]));
+            st.maxVal[c] = max(st.maxVal[c], double(a.hi[c]));
+        }
+    }
+    st.effective = mode == SAMPLE_ROWS ? units : st.pixels;
+    for (int c = 0; c < cn; ++c)
+    {
+        st.mean[c] = sum[c] / max<int64>(st.pixels, 1);
+        st.stddev[c] = sqrt(max(0.0, sq[c] / max<int64>(st.pixels, 1) - st.mean[c] * st.mean[c]));
+    }
+}
+
+static void sampleStats(const Mat &im, ImageStats &st, SampleMode mode = SAMPLE_BLUE_NOISE, int budget = 65536,
+                        uint64 seed = 1)
+{
+    CV_Assert((im.depth() == CV_8U || im.depth() == CV_16U) && im.channels() <= 4 && !im.empty());
+    if (im.depth() == CV_16U)
+        accumulateStats<ushort>(im, mode, budget, seed, st);
+    else
+        accumulateStats<uchar>(im, mode, budget, seed, st);
+}
+
+// Auto levels as buildToneLUT parameters: black and white points at the
+// `clip` and 1 - clip percentiles of all channels pooled, and the gamma
+// that puts the median half way between them.
+static void autoLevels(const ImageStats &st, float &brightness, float &contrast, float &gamma, double clip = 0.005)
+{
+    const double lo = st.percentile(clip) / st.maxValue, hi = st.percentile(1 - clip) / st.maxValue;
+    const double med = st.percentile(0.5) / st.maxValue;
+    brightness = 0.0f;
+    contrast = 1.0f;
+    gamma = 1.0f;
+    if (hi - lo < 1e-3)
+        return;
+
+    // where the median lands between the end points after the gamma; it
+    // rises with gamma, so bisect on log(gamma) within 1/3..3
+    auto position = [&](double g)
+    {
+        const double a = pow(lo, 1 / g), b = pow(hi, 1 / g);
+        return (pow(med, 1 / g) - a) / (b - a);
+    };
+    double gLo = log(1.0 / 3), gHi = log(3.0);
+    for (int i = 0; i < 30; ++i)
+    {
+        const double mid = 0.5 * (gLo + gHi);
+        (position(exp(mid)) < 0.5 ? gLo : gHi) = mid;
+    }
+    const double g = exp(0.5 * (gLo + gHi)), a = pow(lo, 1 / g), b = pow(hi, 1 / g);
+    // toneCurve maps a -> 0 and b -> 1
+    gamma = float(g);
+    contrast = float(1 / (b - a));
+    brightness = float(-0.5 - (a - 0.5) / (b - a));
+}
+
+// ---------- Pointwise colour pipeline ----------
+// A chain of per-pixel colour operations, run in order on CV_32FC3 BGR
+// colours in 0..255 units. It is meant to be baked into a ColorLUT3D, so
+// the stages work on whole batches of colours rather than single pixels.
+class ColorPipeline
+{
+public:
+    // 256-entry CV_8U table, 1 channel for all or 3 for one per channel;
+    // linear between entries
+    ColorPipeline &lut(const Mat &table)
+    {
+        CV_Assert(table.depth() == CV_8U && table.total() == 256 && (table.channels() == 1 || table.channels() == 3));
+        Mat t = table.reshape(1, 256).clone(); // 256 x cn
+        return custom([t](Mat &c)
+        {
+            for (int y = 0; y < c.rows; ++y)
+            {
+                float *p = c.ptr<float>(y);
+                for (int i = 0; i < c.cols * 3; ++i)
+                {
+                    const float v = min(max(p[i], 0.0f), 255.0f);
+                    const int j = min(int(v), 254), ch = t.cols == 3 ? i % 3 : 0;
+                    const float a = t.at<uchar>(j, ch), b = t.at<uchar>(j + 1, ch);
+                    p[i] = a + (v - j) * (b - a);
+                }
+            }
+        });
+    }
+
+    // 3x4 affine matrix as colorMatrix8u takes it
+    ColorPipeline &matrix(const float M[12])
+    {
+        Mat m = Mat(3, 4, CV_32F, const_cast<float *>(M)).clone();
+        return custom([m](Mat &c) { transform(c, c, m); });
+    }
+
+    // v^(1/g) on 0..1, like the tone LUT
+    ColorPipeline &gamma(float g)
+    {
+        const float e = 1.0f / max(g, 1e-6f);
+        return custom([e](Mat &c)
+        {
+            for (int y = 0; y < c.rows; ++y)
+            {
+                float *p = c.ptr<float>(y);
+                for (int i = 0; i < c.cols * 3; ++i)
+                    p[i] = 255.0f * pow(max(p[i], 0.0f) / 255.0f, e);
+            }
+        });
+    }
+
+    // channel k of the result is channel order[k] of the input
+    ColorPipeline &swapChannels(int b, int g, int r)
+    {
+        const int from[6] = {b, 0, g, 1, r, 2};
+        vector<int> pairs(from, from + 6);
+        return custom([pairs](Mat &c)
+        {
+            Mat out(c.size(), c.type());
+            mixChannels(&c, 1, &out, 1, pairs.data(), 3);
+            c = out;
+        });
+    }
+
+    // cvtColor between 3-channel spaces whose float form is 0..1 (BGR/RGB,
+    // YCrCb, XYZ), and HSV/HLS, whose hue in degrees is kept as 0..255.
+    // Other ranges (Lab, Luv) need custom().
+    ColorPipeline &convert(int code)
+    {
+        const bool toHue = code == COLOR_BGR2HSV || code == COLOR_RGB2HSV || code == COLOR_BGR2HLS ||
+                           code == COLOR_RGB2HLS;
+        const bool fromHue = code == COLOR_HSV2BGR || code == COLOR_HSV2RGB || code == COLOR_HLS2BGR ||
+                             code == COLOR_HLS2RGB;
+        return custom([=](Mat &c)
+        {
+            const Scalar in = fromHue ? Scalar(360.0 / 255, 1.0 / 255, 1.0 / 255) : Scalar::all(1.0 / 255);
+            const Scalar out = toHue ? Scalar(255.0 / 360, 255, 255) : Scalar::all(255);
+            multiply(c, in, c);
+            cvtColor(c, c, code);
+            multiply(c, out, c);
+        });
+    }
+
+    // any other pointwise operation on a CV_32FC3 batch in place
+    ColorPipeline &custom(const function<void(Mat &)> &op)
+    {
+        stages.push_back(op);
+        return *this;
+    }
+
+    void evaluate(Mat &colours) const
+    {
+        CV_Assert(colours.type() == CV_32FC3);
+        for (const auto &op : stages)
+            op(colours);
+    }
+
+private:
+    vector<function<void(Mat &)>> stages;
+};
+
+// ---------- 3D LUT ----------
+// A ColorPipeline sampled on a grid^3 lattice over BGR and applied to BGR8
+// in one pass: 33 points per axis with trilinear (8 lookups) or
+// tetrahedral (4 lookups) interpolation, or grid 256 for the exact table
+// of all 2^24 colours (48 MB, one lookup). The interpolated tables keep
+// the lattice values in fixed point, 32 per unit, and unclamped within
+// -1023..1023, so colours pushed out of gamut by the pipeline interpolate
+// correctly and are only saturated at the end.
+class ColorLUT3D
+{
+public:
+    enum Interpolation
+    {
+        TRILINEAR,
+        TETRAHEDRAL
+    };
+
+    explicit ColorLUT3D(const ColorPipeline &pipe, int grid = 33) : grid(grid)
+    {
+        CV_Assert(grid >= 2 && grid <= 256);
+        const int n = grid * grid;
+        if (grid == 256)
+            exact.resize(size_t(grid) * n * 3);
+        else
+            table.resize(size_t(grid) * n * 3);
+        // one b plane per batch; the stages run per batch in parallel
+        parallel_for_(Range(0, grid), [&](const Range &r)
+        {
+            Mat c(n, 1, CV_32FC3);
+            for (int b = r.start; b < r.end; ++b)
+            {
+                for (int g = 0; g < grid; ++g)
+                    for (int rr = 0; rr < grid; ++rr)
+                        c.at<Vec3f>(g * grid + rr) = Vec3f(node(b), node(g), node(rr));
+                pipe.evaluate(c);
+                const float *v = c.ptr<float>();
+                if (grid == 256)
+                    for (int i = 0; i < n * 3; ++i)
+                        exact[size_t(b) * n * 3 + i] = saturate_cast<uchar>(v[i]);
+                else
+                    for (int i = 0; i < n * 3; ++i)
+                        table[size_t(b) * n * 3 + i] = short(cvRound(min(max(v[i], -1023.0f), 1023.0f) * 32));
+            }
+        });
+        // per input value: lattice cell (as a table offset per axis) and
+        // the position in it, 0..256
+        for (int v = 0; v < 256; ++v)
+        {
+            const double pos = v * (grid - 1) / 255.0;
+            const int i = min(int(pos), grid - 2);
+            cell[v] = i;
+            frac[v] = cvRound((pos - i) * 256);
+        }
+    }
+
+    void apply(const Mat &src, Mat &dst, Interpolation interpolation = TETRAHEDRAL) const
+    {
+        CV_Assert(src.type() == CV_8UC3);
+        dst.create(src.size(), CV_8UC3);
+        const int sb = grid * grid * 3, sg = grid * 3, sr = 3;
+        parallel_for_(Range(0, src.rows), [&](const Range &r)
+        {
+            for (int y = r.start; y < r.end; ++y)
+            {
+                const uchar *s = src.ptr<uchar>(y);
+                uchar *d = dst.ptr<uchar>(y);
+                for (int x = 0; x < src.cols; ++x, s += 3, d += 3)
+                {
+                    if (grid == 256)
+                    {
+                        const uchar *c = &exact[s[0] * sb + s[1] * sg + s[2] * sr];
+                        d[0] = c[0];
+                        d[1] = c[1];
+                        d[2] = c[2];
+                        continue;
+                    }
+                    const short *c0 = &table[cell[s[0]] * sb + cell[s[1]] * sg + cell[s[2]] * sr];
+                    const int fb = frac[s[0]], fg = frac[s[1]], fr = frac[s[2]];
+                    if (interpolation == TETRAHEDRAL)
+                    {
+                        // walk from c0 to the far corner along the axes in
+                        // order of decreasing fraction
+                        int f1, f2, f3, o1, o2;
+                        if (fb >= fg)
+                        {
+                            if (fg >= fr)
+                                f1 = fb, f2 = fg, f3 = fr, o1 = sb, o2 = sb + sg;
+                            else if (fb >= fr)
+                                f1 = fb, f2 = fr, f3 = fg, o1 = sb, o2 = sb + sr;
+                            else
+                                f1 = fr, f2 = fb, f3 = fg, o1 = sr, o2 = sr + sb;
+                        }
+                        else
+                        {
+                            if (fb >= fr)
+                                f1 = fg, f2 = fb, f3 = fr, o1 = sg, o2 = sg + sb;
+                            else if (fg >= fr)
+                                f1 = fg, f2 = fr, f3 = fb, o1 = sg, o2 = sg + sr;
+                            else
+                                f1 = fr, f2 = fg, f3 = fb, o1 = sr, o2 = sr + sg;
+                        }
+                        const short *c1 = c0 + o1, *c2 = c0 + o2, *c3 = c0 + sb + sg + sr;
+                        for (int k = 0; k < 3; ++k)
+                        {
+                            const int v = (256 - f1) * c0[k] + (f1 - f2) * c1[k] + (f2 - f3) * c2[k] + f3 * c3[k];
+                            d[k] = saturate_cast<uchar>((v + (1 << 12)) >> 13);
+                        }
+                    }
+                    else
+                    {
+                        for (int k = 0; k < 3; ++k)
+                        {
+                            auto lerp = [](int a, int b, int f) { return (a * (256 - f) + b * f + 128) >> 8; };
+                            const int c00 = lerp(c0[k], c0[sr + k], fr), c01 = lerp(c0[sg + k], c0[sg + sr + k], fr);
+                            const int c10 = lerp(c0[sb + k], c0[sb + sr + k], fr);
+                            const int c11 = lerp(c0[sb + sg + k], c0[sb + sg + sr + k], fr);
+                            const int v = lerp(lerp(c00, c01, fg), lerp(c10, c11, fg), fb);
+                            d[k] = saturate_cast<uchar>((v + 16) >> 5);
+                        }
+                    }
+                }
+            }
+        });
+    }
+
+private:
+    int grid;
+    vector<short> table;  // [b][g][r][channel]
+    vector<uchar> exact;  // the same for grid 256
+    int cell[256], frac[256];
+
+    float node(int i) const { return i * 255.0f / (grid - 1); }
+};
+
+// ---------- Live LUT tuning ----------
+// The trackbar callbacks only note that something moved; the loop rebuilds
+// the LUT once per poll however many events came in, and shows it on a
+// downscaled proxy first. The full image is done once the sliders have
+// been idle for a while.
+struct LiveTuning
+{
+    bool dirty = true;
+    chrono::steady_clock::time_point lastEvent = chrono::steady_clock::now();
+};
+
+static void onTuningChange(int, void *userdata)
+{
+    LiveTuning *live = static_cast<LiveTuning *>(userdata);
+    live->dirty = true;
+    live->lastEvent = chrono::steady_clock::now();
+}
+
+static void liveLUT(const Mat &in, float brightness, float contrast, float gamma)
+{
+    const string win = "Task 1 - LUT live (SPACE=next, Q=quit)";
+    const int proxyWidth = 480, idleMs = 150;
+
+    Mat proxy;
+    const double scale = min(1.0, double(proxyWidth) / in.cols);
+    resize(in, proxy, Size(), scale, scale, INTER_AREA);
+
+    LiveTuning live;
+    namedWindow(win, WINDOW_NORMAL | WINDOW_KEEPRATIO);
+    resizeWindow(win, in.cols, in.rows);
+    // brightness -1..1, contrast 0..4, gamma 0.01..5
+    createTrackbar("Brightness", win, nullptr, 200, onTuningChange, &live);
+    createTrackbar("Contrast x100", win, nullptr, 400, onTuningChange, &live);
+    createTrackbar("Gamma x100", win, nullptr, 500, onTuningChange, &live);
+    setTrackbarPos("Brightness", win, cvRound((brightness + 1.0f) * 100));
+    setTrackbarPos("Contrast x100", win, cvRound(contrast * 100));
+    setTrackbarPos("Gamma x100", win, cvRound(gamma * 100));
+
+    Mat lut, out;
+    bool fullPending = false;
+    while (true)
+    {
+        int key = waitKey(10);
+        if (key == 'q' || key == 'Q')
+            exit(0);
+        else if (key == ' ')
+            break;
+
+        const bool idle = chrono::steady_clock::now() - live.lastEvent > chrono::milliseconds(idleMs);
+        if (!live.dirty && !(fullPending && idle))
+            continue;
+        const Mat &src = live.dirty ? proxy : in;
+        auto t0 = chrono::steady_clock::now();
+        // 16-bit: the proxy gets 256 interpolated segments, rebuilt as fast
+        // as the 8-bit table; the idle full-resolution pass the exact table
+        buildToneLUT(getTrackbarPos("Brightness", win) / 100.0f - 1.0f,
+                     getTrackbarPos("Contrast x100", win) / 100.0f,
+                     max(getTrackbarPos("Gamma x100", win), 1) / 100.0f, lut, in.depth(),
+                     live.dirty ? 256 : 65536);
+        applyToneLUT(src, lut, out);
+        out = to8u(out);
+        double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - t0).count();
+        fullPending = live.dirty;
+        live.dirty = false;
+
+        char buf[64];
+        snprintf(buf, sizeof(buf), "%dx%d: %.3f ms", src.cols, src.rows, ms);
+        putText(out, buf, Point(10, 25), FONT_HERSHEY_SIMPLEX, 0.6, Scalar(255, 255, 255), 2);
+        imshow(win, out);
+    }
+    destroyWindow(win);
+}
+
+// ---------- Colour matrix: brightness, contrast, saturation ----------
+// RGBA matrix for row vectors (out = in * M, offsets in the last row)
+static void adjustmentMatrix(float b, float c, float s, float rgba[16])
+{
+    float t = (1.0f - c) / 2.0f;
+
+    float sr = (1.0f - s) * 0.3086f;
+    float sg = (1.0f - s) * 0.6094f;
+    float sb = (1.0f - s) * 0.0820f;
+
+    const float m[16] = {
+        c * (sr + s), c * (sr), c * (sr), 0.0f,
+        c * (sg), c * (sg + s), c * (sg), 0.0f,
+        c * (sb), c * (sb), c * (sb + s), 0.0f,
+        t + b, t + b, t + b, 1.0f};
+    copy(m, m + 16, rgba);
+}
+
+// the same as a 3x4 BGR matrix for column vectors, offsets in 0..255 units
+static void rgbaToBGRMatrix(const float rgba[16], float bgr[12])
+{
+    for (int k = 0; k < 3; ++k)
+    {
+        for (int l = 0; l < 3; ++l)
+            bgr[k * 4 + l] = rgba[(2 - l) * 4 + (2 - k)];
+        bgr[k * 4 + 3] = rgba[12 + (2 - k)] * 255.0f;
+    }
+}
+
+// ---------- Colour matrix on 8-bit BGR ----------
+// dst = M * (b, g, r, 1) for a row-major 3x4 affine M (rows and columns in
+// B, G, R order, offsets in 0..255 units), saturated to 8 bits. One pass
+// over the interleaved pixels in 16-bit fixed point: the weights are
+// scaled by 2^Q with the largest Q that keeps them in int16 and the sums in
+// int32; each output is two 16-bit multiply-adds (b, g and r, 0) plus the
+// offset, so the result stays within 1 of the float one.
+static void colorMatrix8u(const Mat &src, Mat &dst, const float M[12])
+{
+    CV_Assert(src.type() == CV_8UC3);
+    float maxW = 0, maxSum = 0;
+    for (int k = 0; k < 3; ++k)
+    {
+        float sum = fabs(M[k * 4 + 3]);
+        for (int l = 0; l < 3; ++l)
+        {
+            maxW = max(maxW, fabs(M[k * 4 + l]));
+            sum += 255 * fabs(M[k * 4 + l]);
+        }
+        maxSum = max(maxSum, sum);
+    }
+    int Q = 14;
+    while (Q > 0 && (maxW * (1 << Q) > 32767 || maxSum * (1 << Q) > float(1 << 30)))
+        --Q;
+    CV_Assert(maxW * (1 << Q) <= 32767 && maxSum * (1 << Q) <= float(1 << 30));
+
+    short w[3][3];
+    int offset[3];
+    for (int k = 0; k < 3; ++k)
+    {
+        for (int l = 0; l < 3; ++l)
+            w[k][l] = short(cvRound(M[k * 4 + l] * (1 << Q)));
+        // rounding folded into the offset
+        offset[k] = cvRound(M[k * 4 + 3] * (1 << Q)) + (Q ? 1 << (Q - 1) : 0);
+    }
+
+    dst.create(src.size(), CV_8UC3);
+    parallel_for_(Range(0, src.rows), [&](const Range &r)
+    {
+        for (int y = r.start; y < r.end; ++y)
+        {
+            const uchar *s = src.ptr<uchar>(y);
+            uchar *d = dst.ptr<uchar>(y);
+            int x = 0;
+#if CV_SIMD
+            v_int16 wbg[3], wr0[3];
+            v_int32 off[3];
+            for (int k = 0; k < 3; ++k)
+            {
+                // (b, g) and (r, 0) pairs, as v_zip lays them out
+                v_int16 a = vx_setall_s16(w[k][0]), b = vx_setall_s16(w[k][1]), t;
+                v_zip(a, b, wbg[k], t);
+                a = vx_setall_s16(w[k][2]);
+                b = vx_setall_s16(0);
+                v_zip(a, b, wr0[k], t);
+                off[k] = vx_setall_s32(offset[k]);
+            }
+            const v_int16 zero = vx_setall_s16(0);
+            for (; x <= src.cols - CV_SIMD_WIDTH; x += CV_SIMD_WIDTH)
+            {
+                v_uint8 in[3], out[3];
+                v_load_deinterleave(s + 3 * x, in[0], in[1], in[2]);
+                // pixel halves as int16, then (b, g) and (r, 0) pairs
+                v_uint16 c[3][2];
+                for (int l = 0; l < 3; ++l)
+                    v_expand(in[l], c[l][0], c[l][1]);
+                v_int16 res[3][2];
+                for (int h = 0; h < 2; ++h)
+                {
+                    v_int16 bg[2], r0[2];
+                    v_zip(v_reinterpret_as_s16(c[0][h]), v_reinterpret_as_s16(c[1][h]), bg[0], bg[1]);
+                    v_zip(v_reinterpret_as_s16(c[2][h]), zero, r0[0], r0[1]);
+                    for (int k = 0; k < 3; ++k)
+                    {
+                        v_int32 lo = v_dotprod(r0[0], wr0[k], v_dotprod(bg[0], wbg[k], off[k]));
+                        v_int32 hi = v_dotprod(r0[1], wr0[k], v_dotprod(bg[1], wbg[k], off[k]));
+                        res[k][h] = v_pack(lo >> Q, hi >> Q);
+                    }
+                }
+                for (int k = 0; k < 3; ++k)
+                    out[k] = v_pack_u(res[k][0], res[k][1]);
+                v_store_interleave(d + 3 * x, out[0], out[1], out[2]);
+            }
+#endif
+            for (; x < src.cols; ++x)
+            {
+                const int b = s[3 * x], g = s[3 * x + 1], rr = s[3 * x + 2];
+                for (int k = 0; k < 3; ++k)
+                    d[3 * x + k] = saturate_cast<uchar>((w[k][0] * b + w[k][1] * g + w[k][2] * rr + offset[k]) >> Q);
+            }
+        }
+    });
+}
+
+// ---------- Colour matrix on 16-bit BGR ----------
+// The same on CV_16UC3 with the same M, the offsets scaled from 0..255 to
+// 0..65535. 16-bit weights would cost precision here, so they are 32-bit
+// Q16 fixed point and the sums 64-bit.
+static void colorMatrix16u(const Mat &src, Mat &dst, const float M[12])
+{
+    CV_Assert(src.type() == CV_16UC3);
+    int32_t w[3][3];
+    int64_t offset[3];
+    for (int k = 0; k < 3; ++k)
+    {
+        for (int l = 0; l < 3; ++l)
+        {
+            CV_Assert(fabs(M[k * 4 + l]) < 32767);
+            w[k][l] = cvRound(M[k * 4 + l] * 65536.0);
+        }
+        offset[k] = llround(M[k * 4 + 3] * 257.0 * 65536.0) + (1 << 15);
+    }
+
+    dst.create(src.size(), CV_16UC3);
+    parallel_for_(Range(0, src.rows), [&](const Range &r)
+    {
+        for (int y = r.start; y < r.end; ++y)
+        {
+            const ushort *s = src.ptr<ushort>(y);
+            ushort *d = dst.ptr<ushort>(y);
+            for (int x = 0; x < src.cols; ++x, s += 3, d += 3)
+            {
+                const int64_t b = s[0], g = s[1], rr = s[2];
+                for (int k = 0; k < 3; ++k)
+                    d[k] = saturate_cast<ushort>((w[k][0] * b + w[k][1] * g + w[k][2] * rr + offset[k]) >> 16);
+            }
+        }
+    });
+}
+
 // ---------- Task 1: LUT (brightness, contrast, gamma) ----------
 void taskLUT(const string &filename)
 {
-    Mat in = loadImage(filename, IMREAD_COLOR);
+    // 16-bit images stay 16-bit, with a 65536-entry LUT
+    Mat in = loadImage(filename, IMREAD_COLOR | IMREAD_ANYDEPTH);
     if (in.empty())
         return;
 
@@ -44,23 +835,14 @@ void taskLUT(const string &filename)
     float contrast = 2.0f;
     float gamma = 2.0f;
 
-    Mat lut(1, 256, CV_8UC3);
-    for (int i = 0; i < 256; ++i)
-    {
-        float v = i / 255.0f;
-        float vg = pow(max(v, 0.0f), 1.0f / max(gamma, 1e-6f));
-        float vc = contrast * (vg - 0.5f) + 0.5f;
-        float vb = vc + brightness;
-        vb = min(max(vb, 0.0f), 1.0f);
-        uchar outv = static_cast<uchar>(round(vb * 255.0f));
-        lut.at<Vec3b>(0, i) = Vec3b(outv, outv, outv);
-    }
+    Mat lut;
+    buildToneLUT(brightness, contrast, gamma, lut, in.depth());
 
     Mat outLUT;
-    LUT(in, lut, outLUT);
+    applyToneLUT(in, lut, outLUT);
 
     Mat grid;
-    hconcat(in, outLUT, grid);
+    hconcat(to8u(in), to8u(outLUT), grid);
 
     putText(grid, "Original", Point(10, 30), FONT_HERSHEY_SIMPLEX, 0.8, Scalar(255, 255, 255), 2);
     putText(grid, "LUT (brightness/contrast/gamma)", Point(in.cols + 10, 30),
@@ -71,10 +853,12 @@ void taskLUT(const string &filename)
     waitSpaceOrQuit("Task 1 - LUT (SPACE=next, Q=quit)");
 
     // --- SAFER LUT VISUALIZATION BLOCK ---
+    Mat lut8;
+    buildToneLUT(brightness, contrast, gamma, lut8);
     Mat lutVis(50, 256, CV_8UC3);
     for (int x = 0; x < 256; ++x)
         rectangle(lutVis, Point(x, 0), Point(x, 50),
-                  Scalar(lut.at<Vec3b>(0, x)[0], lut.at<Vec3b>(0, x)[0], lut.at<Vec3b>(0, x)[0]), FILLED);
+                  Scalar::all(lut8.at<uchar>(0, x)), FILLED);
 
     Mat small;
     resize(lutVis, small, Size(grid.cols / 2, 50), 0, 0, INTER_NEAREST);
@@ -103,45 +887,45 @@ void taskLUT(const string &filename)
     imshow("Task 1 - LUT (SPACE=next, Q=quit)", finalGrid);
     waitSpaceOrQuit("Task 1 - LUT (SPACE=next, Q=quit)");
     destroyWindow("Task 1 - LUT (SPACE=next, Q=quit)");
+
+    liveLUT(in, brightness, contrast, gamma);
 }
 
 // ---------- Task 2: Color matrix (brightness, contrast, saturation) ----------
 void taskColorMatrix(const string &filename)
 {
-    Mat in = loadImage(filename, IMREAD_COLOR);
+    Mat in = loadImage(filename, IMREAD_COLOR | IMREAD_ANYDEPTH);
     if (in.empty())
         return;
 
-    float b = 0.0f, c = 2.0f, s = 2.0f;
-    float t = (1.0f - c) / 2.0f;
-
-    float sr = (1.0f - s) * 0.3086f;
-    float sg = (1.0f - s) * 0.6094f;
-    float sb = (1.0f - s) * 0.0820f;
-
-    float customMatrixData[16] = {
-        c * (sr + s), c * (sr), c * (sr), 0.0f,
-        c * (sg), c * (sg + s), c * (sg), 0.0f,
-        c * (sb), c * (sb), c * (sb + s), 0.0f,
-        t + b, t + b, t + b, 1.0f};
-    Mat M(4, 4, CV_32F, customMatrixData);
-
-    Mat working;
-    cvtColor(in, working, COLOR_BGR2RGBA);
-    working.convertTo(working, CV_32F, 1.0 / 255.0);
+    float customMatrixData[16], bgr[12];
+    adjustmentMatrix(0.0f, 2.0f, 2.0f, customMatrixData);
+    rgbaToBGRMatrix(customMatrixData, bgr);
 
-    Mat transformed;
-    transform(working, transformed, M);
-    cv::min(transformed, 1.0f, transformed);
-    cv::max(transformed, 0.0f, transformed);
-
-    Mat outFloat;
-    transformed.convertTo(outFloat, CV_8UC4, 255.0);
+    const bool wide = in.depth() == CV_16U;
     Mat outBGR;
-    cvtColor(outFloat, outBGR, COLOR_RGBA2BGR);
+    auto t0 = chrono::steady_clock::now();
+    if (wide)
+        colorMatrix16u(in, outBGR, bgr);
+    else
+        colorMatrix8u(in, outBGR, bgr);
+    double msFixed = chrono::duration<double, milli>(chrono::steady_clock::now() - t0).count();
+
+    // float reference, offsets in the units of the data
+    Mat m = Mat(3, 4, CV_32F, bgr).clone();
+    for (int k = 0; k < 3 && wide; ++k)
+        m.at<float>(k, 3) *= 257;
+    t0 = chrono::steady_clock::now();
+    Mat working, outFloat;
+    in.convertTo(working, CV_32F);
+    transform(working, working, m);
+    working.convertTo(outFloat, in.depth());
+    double msFloat = chrono::duration<double, milli>(chrono::steady_clock::now() - t0).count();
+    cout << "Colour matrix: fixed point " << msFixed << " ms, float " << msFloat << " ms, max difference "
+         << norm(outBGR, outFloat, NORM_INF) << endl;
 
     Mat grid;
-    hconcat(in, outBGR, grid);
+    hconcat(to8u(in), to8u(outBGR), grid);
     putText(grid, "Original", Point(10, 30), FONT_HERSHEY_SIMPLEX, 0.8, Scalar(255, 255, 255), 2);
     putText(grid, "ColorMatrix (brightness/contrast/saturation)",
             Point(in.cols + 10, 30), FONT_HERSHEY_SIMPLEX, 0.6, Scalar(255, 255, 255), 2);
@@ -168,6 +952,132 @@ void taskColorMatrix(const string &filename)
     destroyWindow("Task 2 - ColorMatrix (SPACE=next, Q=quit)");
 }
 
+// ---------- Task 3: the whole colour pipeline as one 3D LUT ----------
+void taskPipeline(const string &filename)
+{
+    Mat in = loadImage(filename, IMREAD_COLOR);
+    if (in.empty())
+        return;
+
+    // tone curve, saturation matrix, then warmer chroma in YCrCb
+    Mat tone;
+    buildToneLUT(0.0f, 1.2f, 1.2f, tone);
+    float rgba[16], bgr[12];
+    adjustmentMatrix(0.0f, 1.0f, 1.4f, rgba);
+    rgbaToBGRMatrix(rgba, bgr);
+    ColorPipeline pipe;
+    pipe.lut(tone).matrix(bgr).convert(COLOR_BGR2YCrCb).custom([](Mat &c)
+    {
+        add(c, Scalar(0, 6, -6), c);
+    }).convert(COLOR_YCrCb2BGR);
+
+    auto ms = [](chrono::steady_clock::time_point t0)
+    {
+        return chrono::duration<double, milli>(chrono::steady_clock::now() - t0).count();
+    };
+
+    // every stage on the float image, for reference
+    auto t0 = chrono::steady_clock::now();
+    Mat direct;
+    in.convertTo(direct, CV_32F);
+    pipe.evaluate(direct);
+    direct.convertTo(direct, CV_8U);
+    cout << "Pipeline, stage by stage: " << ms(t0) << " ms" << endl;
+
+    Mat baked;
+    for (int grid : {33, 256})
+    {
+        t0 = chrono::steady_clock::now();
+        ColorLUT3D lut3d(pipe, grid);
+        double build = ms(t0);
+        for (int mode : {ColorLUT3D::TETRAHEDRAL, ColorLUT3D::TRILINEAR})
+        {
+            Mat out;
+            t0 = chrono::steady_clock::now();
+            lut3d.apply(in, out, ColorLUT3D::Interpolation(mode));
+            double apply = ms(t0);
+            const char *name = grid == 256 ? "exact" : mode == ColorLUT3D::TETRAHEDRAL ? "tetrahedral" : "trilinear";
+            cout << "3D LUT " << grid << "^3 " << name << ": build " << build << " ms, apply " << apply
+                 << " ms, max difference " << norm(out, direct, NORM_INF) << endl;
+            if (grid == 33 && mode == ColorLUT3D::TETRAHEDRAL)
+                baked = out;
+            if (grid == 256)
+                break; // no interpolation to compare
+        }
+    }
+
+    Mat grid;
+    hconcat(in, direct, grid);
+    hconcat(grid, baked, grid);
+    putText(grid, "Original", Point(10, 30), FONT_HERSHEY_SIMPLEX, 0.8, Scalar(255, 255, 255), 2);
+    putText(grid, "Stage by stage", Point(in.cols + 10, 30), FONT_HERSHEY_SIMPLEX, 0.8, Scalar(255, 255, 255), 2);
+    putText(grid, "33^3 LUT (tetrahedral)", Point(2 * in.cols + 10, 30), FONT_HERSHEY_SIMPLEX, 0.8,
+            Scalar(255, 255, 255), 2);
+
+    namedWindow("Task 3 - 3D LUT (SPACE=next, Q=quit)", WINDOW_AUTOSIZE);
+    imshow("Task 3 - 3D LUT (SPACE=next, Q=quit)", grid);
+    waitSpaceOrQuit("Task 3 - 3D LUT (SPACE=next, Q=quit)");
+    destroyWindow("Task 3 - 3D LUT (SPACE=next, Q=quit)");
+}
+
+// ---------- Task 4: auto levels from sampled statistics ----------
+void taskAutoLevels(const string &filename)
+{
+    Mat in = loadImage(filename, IMREAD_COLOR | IMREAD_ANYDEPTH);
+    if (in.empty())
+        return;
+
+    auto ms = [](chrono::steady_clock::time_point t0)
+    {
+        return chrono::duration<double, milli>(chrono::steady_clock::now() - t0).count();
+    };
+
+    // the full pass is the reference for both the time and the estimates
+    ImageStats full;
+    auto t0 = chrono::steady_clock::now();
+    sampleStats(in, full, SAMPLE_ALL);
+    const double msFull = ms(t0);
+
+    const char *names[] = {"all pixels", "strided rows", "random", "blue noise"};
+    ImageStats st;
+    for (int mode : {SAMPLE_ALL, SAMPLE_ROWS, SAMPLE_RANDOM, SAMPLE_BLUE_NOISE})
+    {
+        t0 = chrono::steady_clock::now();
+        sampleStats(in, st, SampleMode(mode));
+        const double msMode = ms(t0);
+        double lo, hi;
+        st.percentileBounds(0.995, -1, lo, hi);
+        cout << names[mode] << ": " << st.pixels << " px, " << msMode << " ms (" << 100 * msMode / msFull
+             << " % of a pass)" << endl
+             << "  99.5 %: " << st.percentile(0.995) << " in [" << lo << ", " << hi << "], full "
+             << full.percentile(0.995) << endl
+             << "  mean B: " << st.mean[0] << " +- " << st.meanError(0) << ", full " << full.mean[0] << endl
+             << "  range B: " << st.minVal[0] << ".." << st.maxVal[0] << " (at most " << 100 * st.rangeMass()
+             << " % outside), full " << full.minVal[0] << ".." << full.maxVal[0] << endl;
+    }
+
+    // the blue-noise sample (left in st) drives the tone LUT
+    float brightness, contrast, gamma;
+    autoLevels(st, brightness, contrast, gamma);
+    Mat lut, out;
+    buildToneLUT(brightness, contrast, gamma, lut, in.depth());
+    t0 = chrono::steady_clock::now();
+    applyToneLUT(in, lut, out);
+    cout << "Auto levels: brightness " << brightness << ", contrast " << contrast << ", gamma " << gamma
+         << "; correction pass " << ms(t0) << " ms" << endl;
+
+    Mat grid;
+    hconcat(to8u(in), to8u(out), grid);
+    putText(grid, "Original", Point(10, 30), FONT_HERSHEY_SIMPLEX, 0.8, Scalar(255, 255, 255), 2);
+    putText(grid, "Auto levels (blue-noise sample)", Point(in.cols + 10, 30), FONT_HERSHEY_SIMPLEX, 0.7,
+            Scalar(255, 255, 255), 2);
+
+    namedWindow("Task 4 - Auto levels (SPACE=next, Q=quit)", WINDOW_AUTOSIZE);
+    imshow("Task 4 - Auto levels (SPACE=next, Q=quit)", grid);
+    waitSpaceOrQuit("Task 4 - Auto levels (SPACE=next, Q=quit)");
+    destroyWindow("Task 4 - Auto levels (SPACE=next, Q=quit)");
+}
+
 // ---------- Main ----------
 int main(int argc, char **argv)
 {
@@ -181,5 +1091,7 @@ int main(int argc, char **argv)
 
     taskLUT(fname1);
     taskColorMatrix(fname2);
+    taskPipeline(fname2);
+    taskAutoLevels(fname1);
     return 0;
 }
@@ -0,0 +1,473 @@
+#pragma once
+// Procedural test images: gradients, blobs, circles with ground truth,
+// scribbles, impulse noise and moving-object video. Every generator is a
+// Source that fills one row on request, and all randomness is either drawn
+// up front from the seed (shape lists) or hashed from (seed, x, y) (noise),
+// so any row can be made on any thread in any order and the same seed
+// gives the same image at any band size. Large images are never stored:
+// stream() hands them out a band at a time.
+#include <opencv2/opencv.hpp>
+#include <cfloat>
+#include <cstdint>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <vector>
+
+namespace synth
+{
+using namespace cv;
+using namespace std;
+
+// splitmix64 finaliser
+inline uint64_t mix(uint64_t v)
+{
+    v += 0x9E3779B97F4A7C15ull;
+    v = (v ^ (v >> 30)) * 0xBF58476D1CE4E5B9ull;
+    v = (v ^ (v >> 27)) * 0x94D049BB133111EBull;
+    return v ^ (v >> 31);
+}
+
+inline uint64_t pixelHash(uint64_t seed, int64_t x, int64_t y)
+{
+    return mix(seed ^ mix(uint64_t(y) * 0xD1B54A32D192ED03ull + uint64_t(x)));
+}
+
+// [0, 1) from the top 53 bits
+inline double unit(uint64_t h) { return double(h >> 11) * (1.0 / 9007199254740992.0); }
+
+struct Source
+{
+    int rows = 0, cols = 0, type = CV_8UC1;
+    function<void(int y, uchar *row)> row; // writes cols * channels bytes
+};
+
+// ---------- Output ----------
+// Rows [y0, y0 + band.rows) at a time, each band filled in parallel; sink
+// sees the bands in order and must not keep them.
+inline void stream(const Source &s, int bandRows, const function<void(int y0, const Mat &band)> &sink)
+{
+    Mat band(min(bandRows, s.rows), s.cols, s.type);
+    for (int y0 = 0; y0 < s.rows; y0 += bandRows)
+    {
+        Mat b = band.rowRange(0, min(bandRows, s.rows - y0));
+        parallel_for_(Range(0, b.rows), [&](const Range &r)
+        {
+            for (int y = r.start; y < r.end; ++y)
+                s.row(y0 + y, b.ptr<uchar>(y));
+        });
+        sink(y0, b);
+    }
+}
+
+inline Mat render(const Source &s)
+{
+    Mat m(s.rows, s.cols, s.type);
+    parallel_for_(Range(0, s.rows), [&](const Range &r)
+    {
+        for (int y = r.start; y < r.end; ++y)
+            s.row(y, m.ptr<uchar>(y));
+    });
+    return m;
+}
+
+// Binary PGM (1 channel) or PPM (3 channels), written band by band
+inline bool writePNM(const string &path, const Source &s, int bandRows = 256)
+{
+    const int cn = CV_MAT_CN(s.type);
+    CV_Assert(CV_MAT_DEPTH(s.type) == CV_8U && (cn == 1 || cn == 3));
+    ofstream f(path, ios::binary);
+    if (!f)
+        return false;
+    f << (cn == 1 ? "P5" : "P6") << "\n" << s.cols << " " << s.rows << "\n255\n";
+    vector<uchar> rgb(size_t(s.cols) * cn);
+    stream(s, bandRows, [&](int, const Mat &band)
+    {
+        for (int y = 0; y < band.rows; ++y)
+        {
+            const uchar *p = band.ptr<uchar>(y);
+            if (cn == 3) // PPM is RGB
+            {
+                for (int x = 0; x < s.cols; ++x)
+                {
+                    rgb[3 * x] = p[3 * x + 2];
+                    rgb[3 * x + 1] = p[3 * x + 1];
+                    rgb[3 * x + 2] = p[3 * x];
+                }
+                p = &rgb[0];
+            }
+            f.write((const char *)p, size_t(s.cols) * cn);
+        }
+    });
+    return bool(f);
+}
+
+// ---------- Gradients ----------
+enum
+{
+    GRADIENT_HORIZONTAL, // x * 256 / cols, the Lab6 ramp
+    GRADIENT_VERTICAL,   // y * 256 / rows
+    GRADIENT_RADIAL      // 0 in the centre, 255 in the corners
+};
+
+// 1 channel: the ramp itself. 3 channels: B is the ramp, G the vertical
+// ramp and R its mirror, so every pixel has a distinct colour.
+inline Source gradient(int rows, int cols, int kind = GRADIENT_HORIZONTAL, int channels = 1)
+{
+    CV_Assert(channels == 1 || channels == 3);
+    Source s;
+    s.rows = rows;
+    s.cols = cols;
+    s.type = CV_8UC(channels);
+    s.row = [=](int y, uchar *p)
+    {
+        const uchar gy = uchar(int64_t(y) * 256 / rows);
+        const double cx = (cols - 1) * 0.5, cy = (rows - 1) * 0.5;
+        const double dy = y - cy, norm = 255.0 / max(1.0, sqrt(cx * cx + cy * cy));
+        for (int x = 0; x < cols; ++x)
+        {
+            uchar v;
+            if (kind == GRADIENT_HORIZONTAL)
+                v = uchar(int64_t(x) * 256 / cols);
+            else if (kind == GRADIENT_VERTICAL)
+                v = gy;
+            else
+                v = uchar(min(255.0, sqrt((x - cx) * (x - cx) + dy * dy) * norm + 0.5));
+            if (channels == 1)
+                p[x] = v;
+            else
+            {
+                p[3 * x] = v;
+                p[3 * x + 1] = gy;
+                p[3 * x + 2] = uchar(255 - v);
+            }
+        }
+    };
+    return s;
+}
+
+inline Source constant(int rows, int cols, Scalar value, int channels = 1)
+{
+    Source s;
+    s.rows = rows;
+    s.cols = cols;
+    s.type = CV_8UC(channels);
+    uchar v[4];
+    for (int c = 0; c < 4; ++c)
+        v[c] = saturate_cast<uchar>(value[c]);
+    s.row = [=](int, uchar *p)
+    {
+        for (int x = 0; x < cols; ++x)
+            for (int c = 0; c < channels; ++c)
+                p[x * channels + c] = v[c];
+    };
+    return s;
+}
+
+// ---------- Shape layers ----------
+// Every shape is a capsule: the pixels within r of segment ab (a == b is a
+// disc). A capsule is convex, so it covers one x interval per row, found in
+// closed form. Shapes are bucketed by row band so a row only looks at the
+// shapes that reach it; later shapes paint over earlier ones.
+struct Capsule
+{
+    Point2f a, b;
+    float r;
+    Scalar colour;
+};
+
+class Layer
+{
+public:
+    Layer(vector<Capsule> items, int rows, int bucketRows = 64)
+        : shapes(move(items)), bucketRows(bucketRows), buckets((rows + bucketRows - 1) / bucketRows)
+    {
+        for (size_t i = 0; i < shapes.size(); ++i)
+        {
+            const Capsule &c = shapes[i];
+            int y0 = int(floor(min(c.a.y, c.b.y) - c.r)), y1 = int(ceil(max(c.a.y, c.b.y) + c.r));
+            y0 = max(0, y0) / bucketRows;
+            y1 = min(rows - 1, y1);
+            for (int b = y0; y1 >= 0 && b <= y1 / bucketRows; ++b)
+                buckets[b].push_back(int(i));
+        }
+    }
+
+    // paint row y (cols pixels of cn channels) over what is already there
+    void paint(int y, uchar *p, int cols, int cn) const
+    {
+        for (int i : buckets[y / bucketRows])
+        {
+            const Capsule &c = shapes[i];
+            double lo, hi;
+            if (!span(c, y, lo, hi))
+                continue;
+            const int x0 = int(max(0.0, ceil(lo))), x1 = int(min(cols - 1.0, floor(hi)));
+            uchar v[4];
+            for (int k = 0; k < 4; ++k)
+                v[k] = saturate_cast<uchar>(c.colour[k]);
+            for (int x = x0; x <= x1; ++x)
+                for (int k = 0; k < cn; ++k)
+                    p[x * cn + k] = v[k];
+        }
+    }
+
+    const vector<Capsule> &items() const { return shapes; }
+
+private:
+    vector<Capsule> shapes;
+    int bucketRows;
+    vector<vector<int>> buckets;
+
+    // x interval of capsule c on row y: union of the end discs and the band
+    // around the segment, which is an interval because the capsule is convex
+    static bool span(const Capsule &c, double y, double &lo, double &hi)
+    {
+        lo = DBL_MAX;
+        hi = -DBL_MAX;
+        auto disc = [&](Point2f o)
+        {
+            const double dy = y - o.y, s2 = double(c.r) * c.r - dy * dy;
+            if (s2 < 0)
+                return;
+            const double s = sqrt(s2);
+            lo = min(lo, o.x - s);
+            hi = max(hi, o.x + s);
+        };
+        disc(c.a);
+        disc(c.b);
+        const double dx = c.b.x - c.a.x, dy = c.b.y - c.a.y, len = sqrt(dx * dx + dy * dy);
+        if (len > 0)
+        {
+            // along = ((x - ax) dx + (y - ay) dy) / len in [0, len],
+            // across = |(x - ax) dy - (y - ay) dx| / len <= r
+            const double ux = dx / len, uy = dy / len, ry = y - c.a.y;
+            double l = -DBL_MAX, h = DBL_MAX;
+            auto clip = [&](double k, double c0, double cmin, double cmax)
+            {
+                // cmin <= c0 + k x <= cmax
+                if (fabs(k) < 1e-12)
+                {
+                    if (c0 < cmin || c0 > cmax)
+                        h = -DBL_MAX;
+                    return;
+                }
+                double a = (cmin - c0) / k, b = (cmax - c0) / k;
+                if (a > b)
+                    swap(a, b);
+                l = max(l, a);
+                h = min(h, b);
+            };
+            clip(ux, ry * uy, 0, len);
+            clip(uy, -ry * ux, -c.r, c.r);
+            if (l <= h)
+            {
+                lo = min(lo, l + c.a.x);
+                hi = max(hi, h + c.a.x);
+            }
+        }
+        return lo <= hi;
+    }
+};
+
+inline Source overlay(const Source &base, shared_ptr<const Layer> layer)
+{
+    Source s = base;
+    const int cn = CV_MAT_CN(base.type), cols = base.cols;
+    auto fill = base.row;
+    s.row = [=](int y, uchar *p)
+    {
+        fill(y, p);
+        layer->paint(y, p, cols, cn);
+    };
+    return s;
+}
+
+// ---------- Generators ----------
+// Binary blobs (CV_8UC1, 0/255): each is a cluster of overlapping discs
+// around a random centre, like the amoebas of Lab3.
+inline Source blobs(int rows, int cols, int count, float minR, float maxR, uint64_t seed)
+{
+    RNG rng(seed);
+    vector<Capsule> shapes;
+    for (int i = 0; i < count; ++i)
+    {
+        const Point2f centre(rng.uniform(0.f, float(cols)), rng.uniform(0.f, float(rows)));
+        const float r = rng.uniform(minR, maxR);
+        const int parts = rng.uniform(2, 7);
+        for (int j = 0; j < parts; ++j)
+        {
+            const float a = rng.uniform(0.f, float(CV_2PI)), d = rng.uniform(0.f, 0.6f * r);
+            const Point2f o = centre + Point2f(d * cos(a), d * sin(a));
+            shapes.push_back({o, o, rng.uniform(0.4f * r, 0.8f * r), Scalar::all(255)});
+        }
+    }
+    return overlay(constant(rows, cols, Scalar::all(0)), make_shared<Layer>(move(shapes), rows));
+}
+
+// Non-overlapping filled circles (value fg on bg, 1 or 3 channels); their
+// (x, y, r) go to *truth as Vec3f, the same layout HoughCircles uses, in
+// placement order. HoughCircles orders by accumulator votes instead, so
+// callers must match detections to the truth by position. Placement is
+// rejection sampling against a grid of already placed circles, so fewer
+// than `count` fit when the image is crowded.
+inline Source circles(int rows, int cols, int count, float minR, float maxR, uint64_t seed,
+                      vector<Vec3f> *truth = nullptr, int channels = 1,
+                      Scalar fg = Scalar::all(220), Scalar bg = Scalar::all(40))
+{
+    RNG rng(seed);
+    const float cell = 2 * maxR + 2;
+    const int gw = int(cols / cell) + 1, gh = int(rows / cell) + 1;
+    vector<vector<int>> grid(size_t(gw) * gh);
+    vector<Capsule> shapes;
+    for (int attempt = 0; attempt < count * 20 && int(shapes.size()) < count; ++attempt)
+    {
+        const float r = rng.uniform(minR, maxR + 1e-3f);
+        if (cols < 2 * r || rows < 2 * r)
+            break;
+        const Point2f c(rng.uniform(r, cols - r), rng.uniform(r, rows - r));
+        const int gx = int(c.x / cell), gy = int(c.y / cell);
+        bool clear = true;
+        for (int j = max(0, gy - 1); clear && j <= min(gh - 1, gy + 1); ++j)
+            for (int i = max(0, gx - 1); clear && i <= min(gw - 1, gx + 1); ++i)
+                for (int k : grid[size_t(j) * gw + i])
+                {
+                    const Capsule &o = shapes[k];
+                    const Point2f d = o.a - c;
+                    if (d.dot(d) < (o.r + r + 2) * (o.r + r + 2))
+                    {
+                        clear = false;
+                        break;
+                    }
+                }
+        if (!clear)
+            continue;
+        grid[size_t(gy) * gw + gx].push_back(int(shapes.size()));
+        shapes.push_back({c, c, r, fg});
+    }
+    if (truth)
+    {
+        truth->clear();
+        for (const Capsule &s : shapes)
+            truth->push_back(Vec3f(s.a.x, s.a.y, s.r));
+    }
+    return overlay(constant(rows, cols, bg, channels), make_shared<Layer>(move(shapes), rows));
+}
+
+// Random-walk polylines of `thickness` pixels over base, one colour each
+// (Scalar::all(-1) picks a random colour per scribble)
+inline Source scribbles(const Source &base, int count, int thickness, Scalar colour, uint64_t seed,
+                        int segments = 12, float step = 40)
+{
+    RNG rng(seed);
+    vector<Capsule> shapes;
+    for (int i = 0; i < count; ++i)
+    {
+        Scalar col = colour[0] < 0 ? Scalar(rng.uniform(0, 256), rng.uniform(0, 256), rng.uniform(0, 256)) : colour;
+        Point2f p(rng.uniform(0.f, float(base.cols)), rng.uniform(0.f, float(base.rows)));
+        float dir = rng.uniform(0.f, float(CV_2PI));
+        for (int j = 0; j < segments; ++j)
+        {
+            dir += rng.uniform(-0.8f, 0.8f);
+            const Point2f q = p + Point2f(step * cos(dir), step * sin(dir));
+            shapes.push_back({p, q, thickness * 0.5f, col});
+            p = q;
+        }
+    }
+    return overlay(base, make_shared<Layer>(move(shapes), base.rows));
+}
+
+// Salt and pepper: each pixel is replaced with probability `density`,
+// half of them by 0 and half by 255 (all channels)
+inline Source impulseNoise(const Source &base, double density, uint64_t seed)
+{
+    Source s = base;
+    const int cn = CV_MAT_CN(base.type), cols = base.cols;
+    auto fill = base.row;
+    s.row = [=](int y, uchar *p)
+    {
+        fill(y, p);
+        for (int x = 0; x < cols; ++x)
+        {
+            const uint64_t h = pixelHash(seed, x, y);
+            if (unit(h) < density)
+                memset(p + x * cn, (h & 1) ? 255 : 0, cn);
+        }
+    };
+    return s;
+}
+
+// ---------- Video ----------
+// Discs moving at constant velocity and bouncing off the borders over a
+// colour gradient. Positions are a closed-form function of t, so frames can
+// be generated in any order; frame t of a seed is always the same image.
+class MovingScene
+{
+public:
+    MovingScene(int rows, int cols, int count, float minR, float maxR, float maxSpeed, uint64_t seed,
+                double noise = 0)
+        : rows(rows), cols(cols), noise(noise), seed(seed)
+    {
+        RNG rng(seed);
+        for (int i = 0; i < count; ++i)
+        {
+            Object o;
+            o.r = rng.uniform(minR, maxR);
+            o.p = Point2f(rng.uniform(0.f, float(cols)), rng.uniform(0.f, float(rows)));
+            const float a = rng.uniform(0.f, float(CV_2PI)), v = rng.uniform(0.2f * maxSpeed, maxSpeed);
+            o.v = Point2f(v * cos(a), v * sin(a));
+            o.colour = Scalar(rng.uniform(0, 256), rng.uniform(0, 256), rng.uniform(0, 256));
+            objects.push_back(o);
+        }
+    }
+
+    // object i at frame t, (x, y, r)
+    Vec3f position(int i, int t) const
+    {
+        const Object &o = objects[i];
+        return Vec3f(bounce(o.p.x + o.v.x * t, o.r, cols - o.r), bounce(o.p.y + o.v.y * t, o.r, rows - o.r), o.r);
+    }
+
+    Source frame(int t, vector<Vec3f> *truth = nullptr) const
+    {
+        vector<Capsule> shapes;
+        if (truth)
+            truth->clear();
+        for (size_t i = 0; i < objects.size(); ++i)
+        {
+            const Vec3f p = position(int(i), t);
+            shapes.push_back({Point2f(p[0], p[1]), Point2f(p[0], p[1]), p[2], objects[i].colour});
+            if (truth)
+                truth->push_back(p);
+        }
+        Source s = overlay(gradient(rows, cols, GRADIENT_RADIAL, 3), make_shared<Layer>(move(shapes), rows));
+        return noise > 0 ? impulseNoise(s, noise, mix(seed + uint64_t(t))) : s;
+    }
+
+    int objectCount() const { return int(objects.size()); }
+
+private:
+    struct Object
+    {
+        Point2f p, v;
+        float r;
+        Scalar colour;
+    };
+    int rows, cols;
+    double noise;
+    uint64_t seed;
+    vector<Object> objects;
+
+    // reflect v into [lo, hi] (a triangle wave)
+    static float bounce(double v, double lo, double hi)
+    {
+        const double w = hi - lo;
+        if (w <= 0)
+            return float((lo + hi) * 0.5);
+        double u = fmod(v - lo, 2 * w);
+        if (u < 0)
+            u += 2 * w;
+        return float(lo + (u <= w ? u : 2 * w - u));
+    }
+};
+} // namespace synth